@@ -76,6 +76,10 @@
 
 #define SO_SELECT_ERR_QUEUE	45
 
+#define SO_BUSY_POLL	46
+
+#define SO_ZEROCOPY	60
+
 #endif /* _ASM_SOCKET_H */
 
 
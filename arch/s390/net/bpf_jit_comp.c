@@ -798,8 +798,10 @@ void bpf_jit_compile(struct sk_filter *fp)
 				       jit.mid, jit.end - jit.mid, false);
 		}
 	}
-	if (jit.start)
+	if (jit.start) {
 		fp->bpf_func = (void *) jit.start;
+		fp->jited = 1;
+	}
 out:
 	kfree(addrs);
 }
@@ -816,7 +818,7 @@ void bpf_jit_free(struct sk_filter *fp)
 {
 	struct work_struct *work;
 
-	if (fp->bpf_func == sk_run_filter)
+	if (!fp->jited)
 		return;
 	work = (struct work_struct *)fp->bpf_func;
 	INIT_WORK(work, jit_free_defer);
@@ -41,6 +41,7 @@
 #include <linux/if_vlan.h>
 #include <linux/i2c.h>
 #include <linux/i2c-algo-bit.h>
+#include <net/busy_poll.h>
 
 struct igb_adapter;
 
@@ -254,6 +255,7 @@ struct igb_ring {
 	u16 next_to_clean;
 	u16 next_to_use;
 	u16 next_to_alloc;
+	u16 next_to_notify;		/* Tx: last value written to tail */
 
 	union {
 		/* TX */
@@ -286,10 +288,157 @@ struct igb_q_vector {
 	struct rcu_head rcu;	/* to avoid race with update stats on free */
 	char name[IFNAMSIZ + 9];
 
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	unsigned int state;
+#define IGB_QV_STATE_IDLE	0
+#define IGB_QV_STATE_NAPI	1	/* NAPI owns this QV */
+#define IGB_QV_STATE_POLL	2	/* poll owns this QV */
+#define IGB_QV_STATE_DISABLED	4	/* QV is disabled */
+#define IGB_QV_OWNED (IGB_QV_STATE_NAPI | IGB_QV_STATE_POLL)
+#define IGB_QV_LOCKED (IGB_QV_OWNED | IGB_QV_STATE_DISABLED)
+#define IGB_QV_STATE_NAPI_YIELD	8	/* NAPI yielded this QV */
+#define IGB_QV_STATE_POLL_YIELD	16	/* poll yielded this QV */
+#define IGB_QV_YIELD (IGB_QV_STATE_NAPI_YIELD | IGB_QV_STATE_POLL_YIELD)
+#define IGB_QV_USER_PEND (IGB_QV_STATE_POLL | IGB_QV_STATE_POLL_YIELD)
+	spinlock_t lock;
+#endif /* CONFIG_NET_RX_BUSY_POLL */
+
 	/* for dynamic allocation of rings associated with this q_vector */
 	struct igb_ring ring[0] ____cacheline_internodealigned_in_smp;
 };
 
+#ifdef CONFIG_NET_RX_BUSY_POLL
+static inline void igb_qv_init_lock(struct igb_q_vector *q_vector)
+{
+	spin_lock_init(&q_vector->lock);
+	q_vector->state = IGB_QV_STATE_IDLE;
+}
+
+/* called from igb_poll() to get ownership of a q_vector */
+static inline bool igb_qv_lock_napi(struct igb_q_vector *q_vector)
+{
+	bool rc = true;
+
+	spin_lock_bh(&q_vector->lock);
+	if (q_vector->state & IGB_QV_LOCKED) {
+		WARN_ON(q_vector->state & IGB_QV_STATE_NAPI);
+		q_vector->state |= IGB_QV_STATE_NAPI_YIELD;
+		rc = false;
+	} else {
+		/* we don't care if someone yielded */
+		q_vector->state = IGB_QV_STATE_NAPI;
+	}
+	spin_unlock_bh(&q_vector->lock);
+	return rc;
+}
+
+/* returns true if someone tried to get the qv while napi had it */
+static inline bool igb_qv_unlock_napi(struct igb_q_vector *q_vector)
+{
+	bool rc = false;
+
+	spin_lock_bh(&q_vector->lock);
+	WARN_ON(q_vector->state & (IGB_QV_STATE_POLL |
+				   IGB_QV_STATE_NAPI_YIELD));
+
+	if (q_vector->state & IGB_QV_STATE_POLL_YIELD)
+		rc = true;
+	/* will reset state to idle, unless QV is disabled */
+	q_vector->state &= IGB_QV_STATE_DISABLED;
+	spin_unlock_bh(&q_vector->lock);
+	return rc;
+}
+
+/* called from igb_busy_poll_recv() */
+static inline bool igb_qv_lock_poll(struct igb_q_vector *q_vector)
+{
+	bool rc = true;
+
+	spin_lock_bh(&q_vector->lock);
+	if (q_vector->state & IGB_QV_LOCKED) {
+		q_vector->state |= IGB_QV_STATE_POLL_YIELD;
+		rc = false;
+	} else {
+		/* preserve yield marks */
+		q_vector->state |= IGB_QV_STATE_POLL;
+	}
+	spin_unlock_bh(&q_vector->lock);
+	return rc;
+}
+
+/* returns true if someone tried to get the qv while it was locked */
+static inline bool igb_qv_unlock_poll(struct igb_q_vector *q_vector)
+{
+	bool rc = false;
+
+	spin_lock_bh(&q_vector->lock);
+	WARN_ON(q_vector->state & IGB_QV_STATE_NAPI);
+
+	if (q_vector->state & IGB_QV_STATE_POLL_YIELD)
+		rc = true;
+	/* will reset state to idle, unless QV is disabled */
+	q_vector->state &= IGB_QV_STATE_DISABLED;
+	spin_unlock_bh(&q_vector->lock);
+	return rc;
+}
+
+/* true if a socket is polling, even if it did not get the lock */
+static inline bool igb_qv_busy_polling(struct igb_q_vector *q_vector)
+{
+	WARN_ON(!(q_vector->state & IGB_QV_OWNED));
+	return q_vector->state & IGB_QV_USER_PEND;
+}
+
+/* false if QV is currently owned */
+static inline bool igb_qv_disable(struct igb_q_vector *q_vector)
+{
+	bool rc = true;
+
+	spin_lock_bh(&q_vector->lock);
+	if (q_vector->state & IGB_QV_OWNED)
+		rc = false;
+	q_vector->state |= IGB_QV_STATE_DISABLED;
+	spin_unlock_bh(&q_vector->lock);
+	return rc;
+}
+
+#else /* CONFIG_NET_RX_BUSY_POLL */
+static inline void igb_qv_init_lock(struct igb_q_vector *q_vector)
+{
+}
+
+static inline bool igb_qv_lock_napi(struct igb_q_vector *q_vector)
+{
+	return true;
+}
+
+static inline bool igb_qv_unlock_napi(struct igb_q_vector *q_vector)
+{
+	return false;
+}
+
+static inline bool igb_qv_lock_poll(struct igb_q_vector *q_vector)
+{
+	return false;
+}
+
+static inline bool igb_qv_unlock_poll(struct igb_q_vector *q_vector)
+{
+	return false;
+}
+
+static inline bool igb_qv_busy_polling(struct igb_q_vector *q_vector)
+{
+	return false;
+}
+
+static inline bool igb_qv_disable(struct igb_q_vector *q_vector)
+{
+	return true;
+}
+
+#endif /* CONFIG_NET_RX_BUSY_POLL */
+
 enum e1000_ring_flags_t {
 	IGB_RING_FLAG_RX_SCTP_CSUM,
 	IGB_RING_FLAG_RX_LB_VLAN_BSWAP,
@@ -154,7 +154,7 @@ static void igb_setup_dca(struct igb_adapter *);
 #endif /* CONFIG_IGB_DCA */
 static int igb_poll(struct napi_struct *, int);
 static bool igb_clean_tx_irq(struct igb_q_vector *);
-static bool igb_clean_rx_irq(struct igb_q_vector *, int);
+static int igb_clean_rx_irq(struct igb_q_vector *, int);
 static int igb_ioctl(struct net_device *, struct ifreq *, int cmd);
 static void igb_tx_timeout(struct net_device *);
 static void igb_reset_task(struct work_struct *);
@@ -1011,6 +1011,7 @@ static void igb_free_q_vector(struct igb_adapter *adapter, int v_idx)
 		adapter->tx_ring[q_vector->rx.ring->queue_index] = NULL;
 
 	adapter->q_vector[v_idx] = NULL;
+	napi_hash_del(&q_vector->napi);
 	netif_napi_del(&q_vector->napi);
 
 	/* ixgbe_get_stats64() might access the rings on this vector,
@@ -1176,6 +1177,7 @@ static int igb_alloc_q_vector(struct igb_adapter *adapter,
 	/* initialize NAPI */
 	netif_napi_add(adapter->netdev, &q_vector->napi,
 		       igb_poll, 64);
+	napi_hash_add(&q_vector->napi);
 
 	/* tie q_vector and adapter together */
 	adapter->q_vector[v_idx] = q_vector;
@@ -1612,8 +1614,10 @@ int igb_up(struct igb_adapter *adapter)
 
 	clear_bit(__IGB_DOWN, &adapter->state);
 
-	for (i = 0; i < adapter->num_q_vectors; i++)
+	for (i = 0; i < adapter->num_q_vectors; i++) {
+		igb_qv_init_lock(adapter->q_vector[i]);
 		napi_enable(&(adapter->q_vector[i]->napi));
+	}
 
 	if (adapter->msix_entries)
 		igb_configure_msix(adapter);
@@ -1667,8 +1671,11 @@ void igb_down(struct igb_adapter *adapter)
 	wrfl();
 	msleep(10);
 
-	for (i = 0; i < adapter->num_q_vectors; i++)
+	for (i = 0; i < adapter->num_q_vectors; i++) {
 		napi_disable(&(adapter->q_vector[i]->napi));
+		while (!igb_qv_disable(adapter->q_vector[i]))
+			usleep_range(1000, 20000);
+	}
 
 	igb_irq_disable(adapter);
 
@@ -1909,6 +1916,9 @@ static const struct net_device_ops igb_netdev_ops = {
 	.ndo_get_vf_config	= igb_ndo_get_vf_config,
 #ifdef CONFIG_NET_POLL_CONTROLLER
 	.ndo_poll_controller	= igb_netpoll,
+#endif
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	.ndo_busy_poll		= igb_busy_poll_recv,
 #endif
 	.ndo_fix_features	= igb_fix_features,
 	.ndo_set_features	= igb_set_features,
@@ -2794,8 +2804,10 @@ static int __igb_open(struct net_device *netdev, bool resuming)
 	/* From here on the code is the same as igb_up() */
 	clear_bit(__IGB_DOWN, &adapter->state);
 
-	for (i = 0; i < adapter->num_q_vectors; i++)
+	for (i = 0; i < adapter->num_q_vectors; i++) {
+		igb_qv_init_lock(adapter->q_vector[i]);
 		napi_enable(&(adapter->q_vector[i]->napi));
+	}
 
 	/* Clear any pending interrupts. */
 	rd32(E1000_ICR);
@@ -2997,6 +3009,7 @@ void igb_configure_tx_ring(struct igb_adapter *adapter,
 	ring->tail = hw->hw_addr + E1000_TDT(reg_idx);
 	wr32(E1000_TDH(reg_idx), 0);
 	writel(0, ring->tail);
+	ring->next_to_notify = 0;
 
 	txdctl |= IGB_TX_PTHRESH;
 	txdctl |= IGB_TX_HTHRESH << 8;
@@ -4459,6 +4472,61 @@ static void igb_tx_olinfo_status(struct igb_ring *tx_ring,
 	tx_desc->read.olinfo_status = cpu_to_le32(olinfo_status);
 }
 
+static int __igb_maybe_stop_tx(struct igb_ring *tx_ring, const u16 size)
+{
+	struct net_device *netdev = tx_ring->netdev;
+
+	netif_stop_subqueue(netdev, tx_ring->queue_index);
+
+	/* Herbert's original patch had:
+	 *  smp_mb__after_netif_stop_queue();
+	 * but since that doesn't exist yet, just open code it.
+	 */
+	smp_mb();
+
+	/* We need to check again in a case another CPU has just
+	 * made room available.
+	 */
+	if (igb_desc_unused(tx_ring) < size)
+		return -EBUSY;
+
+	/* A reprieve! */
+	netif_wake_subqueue(netdev, tx_ring->queue_index);
+
+	u64_stats_update_begin(&tx_ring->tx_syncp2);
+	tx_ring->tx_stats.restart_queue2++;
+	u64_stats_update_end(&tx_ring->tx_syncp2);
+
+	return 0;
+}
+
+static inline int igb_maybe_stop_tx(struct igb_ring *tx_ring, const u16 size)
+{
+	if (igb_desc_unused(tx_ring) >= size)
+		return 0;
+	return __igb_maybe_stop_tx(tx_ring, size);
+}
+
+/* Hand the descriptors queued since the last tail update to hardware.
+ * Also called when a packet is dropped, as the tail update held back
+ * for it under xmit_more would otherwise never happen.
+ */
+static void igb_tx_notify(struct igb_ring *tx_ring)
+{
+	u16 i = tx_ring->next_to_use;
+
+	if (i == tx_ring->next_to_notify)
+		return;
+
+	tx_ring->next_to_notify = i;
+	writel(i, tx_ring->tail);
+
+	/* we need this if more than one processor can write to our
+	 * tail at a time, it synchronizes IO on IA64/Altix systems
+	 */
+	mmiowb();
+}
+
 static void igb_tx_map(struct igb_ring *tx_ring,
 		       struct igb_tx_buffer *first,
 		       const u8 hdr_len)
@@ -4561,12 +4629,14 @@ static void igb_tx_map(struct igb_ring *tx_ring,
 
 	tx_ring->next_to_use = i;
 
-	writel(i, tx_ring->tail);
+	/* Make sure there is space in the ring for the next send. */
+	igb_maybe_stop_tx(tx_ring, DESC_NEEDED);
 
-	/* we need this if more than one processor can write to our tail
-	 * at a time, it synchronizes IO on IA64/Altix systems
+	/* the stack may hold back the tail update while it has more
+	 * packets queued for us, as long as the queue is still open
 	 */
-	mmiowb();
+	if (netif_xmit_stopped(txring_txq(tx_ring)) || !first->skb->xmit_more)
+		igb_tx_notify(tx_ring);
 
 	return;
 
@@ -4585,41 +4655,8 @@ dma_error:
 	}
 
 	tx_ring->next_to_use = i;
-}
-
-static int __igb_maybe_stop_tx(struct igb_ring *tx_ring, const u16 size)
-{
-	struct net_device *netdev = tx_ring->netdev;
-
-	netif_stop_subqueue(netdev, tx_ring->queue_index);
-
-	/* Herbert's original patch had:
-	 *  smp_mb__after_netif_stop_queue();
-	 * but since that doesn't exist yet, just open code it.
-	 */
-	smp_mb();
-
-	/* We need to check again in a case another CPU has just
-	 * made room available.
-	 */
-	if (igb_desc_unused(tx_ring) < size)
-		return -EBUSY;
-
-	/* A reprieve! */
-	netif_wake_subqueue(netdev, tx_ring->queue_index);
 
-	u64_stats_update_begin(&tx_ring->tx_syncp2);
-	tx_ring->tx_stats.restart_queue2++;
-	u64_stats_update_end(&tx_ring->tx_syncp2);
-
-	return 0;
-}
-
-static inline int igb_maybe_stop_tx(struct igb_ring *tx_ring, const u16 size)
-{
-	if (igb_desc_unused(tx_ring) >= size)
-		return 0;
-	return __igb_maybe_stop_tx(tx_ring, size);
+	igb_tx_notify(tx_ring);
 }
 
 netdev_tx_t igb_xmit_frame_ring(struct sk_buff *skb,
@@ -4648,6 +4685,7 @@ netdev_tx_t igb_xmit_frame_ring(struct sk_buff *skb,
 
 	if (igb_maybe_stop_tx(tx_ring, count + 3)) {
 		/* this is a hard error */
+		igb_tx_notify(tx_ring);
 		return NETDEV_TX_BUSY;
 	}
 
@@ -4690,13 +4728,11 @@ netdev_tx_t igb_xmit_frame_ring(struct sk_buff *skb,
 
 	igb_tx_map(tx_ring, first, hdr_len);
 
-	/* Make sure there is space in the ring for the next send. */
-	igb_maybe_stop_tx(tx_ring, DESC_NEEDED);
-
 	return NETDEV_TX_OK;
 
 out_drop:
 	igb_unmap_and_free_tx_resource(tx_ring, first);
+	igb_tx_notify(tx_ring);
 
 	return NETDEV_TX_OK;
 }
@@ -5957,8 +5993,14 @@ static int igb_poll(struct napi_struct *napi, int budget)
 	if (q_vector->tx.ring)
 		clean_complete = igb_clean_tx_irq(q_vector);
 
+	/* a socket busy polling this q_vector owns the Rx ring */
+	if (!igb_qv_lock_napi(q_vector))
+		return budget;
+
 	if (q_vector->rx.ring)
-		clean_complete &= igb_clean_rx_irq(q_vector, budget);
+		clean_complete &= (igb_clean_rx_irq(q_vector, budget) < budget);
+
+	igb_qv_unlock_napi(q_vector);
 
 	/* If all work not completed, return budget and keep polling */
 	if (!clean_complete)
@@ -5971,6 +6013,38 @@ static int igb_poll(struct napi_struct *napi, int budget)
 	return 0;
 }
 
+#ifdef CONFIG_NET_RX_BUSY_POLL
+/**
+ *  igb_busy_poll_recv - busy poll the Rx ring of a q_vector
+ *  @napi: napi struct embedded in the q_vector to poll
+ *
+ *  Called from the socket layer with bottom halves disabled.  Returns the
+ *  number of packets cleaned, or LL_FLUSH_BUSY if NAPI currently owns the
+ *  q_vector.
+ **/
+static int igb_busy_poll_recv(struct napi_struct *napi)
+{
+	struct igb_q_vector *q_vector = container_of(napi,
+						     struct igb_q_vector,
+						     napi);
+	struct igb_adapter *adapter = q_vector->adapter;
+	int found = 0;
+
+	if (test_bit(__IGB_DOWN, &adapter->state))
+		return LL_FLUSH_FAILED;
+
+	if (!igb_qv_lock_poll(q_vector))
+		return LL_FLUSH_BUSY;
+
+	if (q_vector->rx.ring)
+		found = igb_clean_rx_irq(q_vector, 4);
+
+	igb_qv_unlock_poll(q_vector);
+
+	return found;
+}
+#endif /* CONFIG_NET_RX_BUSY_POLL */
+
 /**
  *  igb_clean_tx_irq - Reclaim resources after transmit completes
  *  @q_vector: pointer to q_vector containing needed info
@@ -6641,7 +6715,7 @@ static void igb_process_skb_fields(struct igb_ring *rx_ring,
 	skb->protocol = eth_type_trans(skb, rx_ring->netdev);
 }
 
-static bool igb_clean_rx_irq(struct igb_q_vector *q_vector, const int budget)
+static int igb_clean_rx_irq(struct igb_q_vector *q_vector, const int budget)
 {
 	struct igb_ring *rx_ring = q_vector->rx.ring;
 	struct sk_buff *skb = rx_ring->skb;
@@ -6693,7 +6767,11 @@ static bool igb_clean_rx_irq(struct igb_q_vector *q_vector, const int budget)
 		/* populate checksum, timestamp, VLAN, and protocol */
 		igb_process_skb_fields(rx_ring, rx_desc, skb);
 
-		napi_gro_receive(&q_vector->napi, skb);
+		skb_mark_napi_id(skb, &q_vector->napi);
+		if (igb_qv_busy_polling(q_vector))
+			netif_receive_skb(skb);
+		else
+			napi_gro_receive(&q_vector->napi, skb);
 
 		/* reset skb pointer */
 		skb = NULL;
@@ -6715,7 +6793,7 @@ static bool igb_clean_rx_irq(struct igb_q_vector *q_vector, const int budget)
 	if (cleaned_count)
 		igb_alloc_rx_buffers(rx_ring, cleaned_count);
 
-	return (total_packets < budget);
+	return total_packets;
 }
 
 static bool igb_alloc_mapped_page(struct igb_ring *rx_ring,
@@ -105,6 +105,8 @@ static const struct ixgbe_stats ixgbe_gstrings_stats[] = {
 	{"rx_csum_offload_errors", IXGBE_STAT(hw_csum_rx_error)},
 	{"alloc_rx_page_failed", IXGBE_STAT(alloc_rx_page_failed)},
 	{"alloc_rx_buff_failed", IXGBE_STAT(alloc_rx_buff_failed)},
+	{"rx_xdp_drop", IXGBE_STAT(xdp_drop)},
+	{"rx_xdp_tx", IXGBE_STAT(xdp_tx)},
 	{"rx_no_dma_resources", IXGBE_STAT(hw_rx_no_dma_resources)},
 	{"os2bmc_rx_by_bmc", IXGBE_STAT(stats.o2bgptc)},
 	{"os2bmc_tx_by_bmc", IXGBE_STAT(stats.b2ospc)},
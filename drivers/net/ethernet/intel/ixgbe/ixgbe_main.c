@@ -46,6 +46,7 @@
 #include <linux/if_vlan.h>
 #include <linux/if_bridge.h>
 #include <linux/prefetch.h>
+#include <linux/filter.h>
 #include <scsi/fc/fc_fcoe.h>
 
 #include "ixgbe.h"
@@ -1240,15 +1241,17 @@ static bool ixgbe_alloc_mapped_page(struct ixgbe_ring *rx_ring,
 	if (likely(dma))
 		return true;
 
-	/* alloc new page for storage */
+	/* alloc new page for storage, pages from the pool are mapped */
 	if (likely(!page)) {
-		page = __skb_alloc_pages(GFP_ATOMIC | __GFP_COLD | __GFP_COMP,
-					 bi->skb, ixgbe_rx_pg_order(rx_ring));
+		page = page_pool_alloc_pages(rx_ring->page_pool,
+					     GFP_ATOMIC | __GFP_COLD | __GFP_COMP,
+					     &dma);
 		if (unlikely(!page)) {
 			rx_ring->rx_stats.alloc_rx_page_failed++;
 			return false;
 		}
 		bi->page = page;
+		goto done;
 	}
 
 	/* map page for use */
@@ -1267,6 +1270,7 @@ static bool ixgbe_alloc_mapped_page(struct ixgbe_ring *rx_ring,
 		return false;
 	}
 
+done:
 	bi->dma = dma;
 	bi->page_offset = 0;
 
@@ -1504,10 +1508,13 @@ static void ixgbe_rx_skb(struct ixgbe_q_vector *q_vector,
 {
 	struct ixgbe_adapter *adapter = q_vector->adapter;
 
-	if (!(adapter->flags & IXGBE_FLAG_IN_NETPOLL))
-		napi_gro_receive(&q_vector->napi, skb);
-	else
+	skb_mark_napi_id(skb, &q_vector->napi);
+	if (adapter->flags & IXGBE_FLAG_IN_NETPOLL)
 		netif_rx(skb);
+	else if (ixgbe_qv_busy_polling(q_vector))
+		netif_receive_skb(skb);
+	else
+		napi_gro_receive(&q_vector->napi, skb);
 }
 
 /**
@@ -1867,10 +1874,8 @@ dma_sync:
 		/* the page has been released from the ring */
 		IXGBE_CB(skb)->page_released = true;
 	} else {
-		/* we are not reusing the buffer so unmap it */
-		dma_unmap_page(rx_ring->dev, rx_buffer->dma,
-			       ixgbe_rx_pg_size(rx_ring),
-			       DMA_FROM_DEVICE);
+		/* we are not reusing the buffer, the pool keeps it mapped */
+		page_pool_recycle(rx_ring->page_pool, page, rx_buffer->dma);
 	}
 
 	/* clear contents of buffer_info */
@@ -1881,6 +1886,107 @@ dma_sync:
 	return skb;
 }
 
+/**
+ * ixgbe_run_xdp - run the Rx program on a frame before building an skb
+ * @rx_ring: rx descriptor ring the frame was received on
+ * @rx_desc: descriptor of the frame
+ * @prog: program attached to the adapter
+ *
+ * Only frames held in a single buffer are shown to the program, frames
+ * spanning several descriptors or flagged with an error are passed on.
+ *
+ * Returns one of enum xdp_action
+ **/
+static u32 ixgbe_run_xdp(struct ixgbe_ring *rx_ring,
+			 union ixgbe_adv_rx_desc *rx_desc,
+			 const struct sk_filter *prog)
+{
+	struct ixgbe_rx_buffer *rx_buffer;
+	void *va;
+
+	rx_buffer = &rx_ring->rx_buffer_info[rx_ring->next_to_clean];
+	if (rx_buffer->skb || !rx_ring->xdp_ctx ||
+	    !ixgbe_test_staterr(rx_desc, IXGBE_RXD_STAT_EOP) ||
+	    ixgbe_test_staterr(rx_desc, IXGBE_RXDADV_ERR_FRAME_ERR_MASK))
+		return XDP_PASS;
+
+	dma_sync_single_range_for_cpu(rx_ring->dev,
+				      rx_buffer->dma,
+				      rx_buffer->page_offset,
+				      ixgbe_rx_bufsz(rx_ring),
+				      DMA_FROM_DEVICE);
+
+	va = page_address(rx_buffer->page) + rx_buffer->page_offset;
+	prefetch(va);
+
+	return sk_filter_run_frame(prog, rx_ring->xdp_ctx, va,
+				   le16_to_cpu(rx_desc->wb.upper.length));
+}
+
+/**
+ * ixgbe_xdp_drop - recycle the buffer of a frame dropped by the Rx program
+ * @rx_ring: rx descriptor ring the frame was received on
+ *
+ * The page never left the ring, so the same half is handed back to the
+ * hardware and next to clean moves on without an skb being allocated.
+ **/
+static void ixgbe_xdp_drop(struct ixgbe_ring *rx_ring)
+{
+	struct ixgbe_rx_buffer *rx_buffer;
+	u32 ntc = rx_ring->next_to_clean;
+
+	rx_buffer = &rx_ring->rx_buffer_info[ntc];
+	ixgbe_reuse_rx_page(rx_ring, rx_buffer);
+
+	rx_buffer->dma = 0;
+	rx_buffer->page = NULL;
+
+	ntc++;
+	ntc = (ntc < rx_ring->count) ? ntc : 0;
+	rx_ring->next_to_clean = ntc;
+
+	prefetch(IXGBE_RX_DESC(rx_ring, ntc));
+
+	rx_ring->rx_stats.xdp_drop++;
+}
+
+/**
+ * ixgbe_xdp_xmit - send a frame back out the port it was received on
+ * @rx_ring: rx descriptor ring the frame was received on
+ * @skb: frame, as returned by ixgbe_process_skb_fields()
+ *
+ * The frame goes straight to the Tx ring paired with @rx_ring, bypassing
+ * the qdisc layer; it is dropped if that ring is stopped.
+ **/
+static void ixgbe_xdp_xmit(struct ixgbe_ring *rx_ring, struct sk_buff *skb)
+{
+	struct ixgbe_adapter *adapter = rx_ring->q_vector->adapter;
+	struct ixgbe_ring *tx_ring;
+	struct netdev_queue *txq;
+	netdev_tx_t ret = NETDEV_TX_BUSY;
+
+	/* restore the Ethernet header eth_type_trans() pulled */
+	skb_push(skb, ETH_HLEN);
+	skb_set_network_header(skb, ETH_HLEN);
+
+	tx_ring = adapter->tx_ring[rx_ring->queue_index %
+				   adapter->num_tx_queues];
+	txq = txring_txq(tx_ring);
+
+	__netif_tx_lock(txq, smp_processor_id());
+	if (!netif_xmit_frozen_or_stopped(txq))
+		ret = ixgbe_xmit_frame_ring(skb, adapter, tx_ring);
+	__netif_tx_unlock(txq);
+
+	if (ret != NETDEV_TX_OK) {
+		dev_kfree_skb_any(skb);
+		rx_ring->rx_stats.xdp_drop++;
+		return;
+	}
+
+	rx_ring->rx_stats.xdp_tx++;
+}
+
 /**
  * ixgbe_clean_rx_irq - Clean completed descriptors from Rx ring - bounce buf
  * @q_vector: structure containing interrupt and ring information
@@ -1892,9 +1998,9 @@ dma_sync:
  * expensive overhead for IOMMU access this provides a means of avoiding
  * it by maintaining the mapping of the page to the syste.
  *
- * Returns true if all work is completed without reaching budget
+ * Returns amount of work completed
  **/
-static bool ixgbe_clean_rx_irq(struct ixgbe_q_vector *q_vector,
+static int ixgbe_clean_rx_irq(struct ixgbe_q_vector *q_vector,
 			       struct ixgbe_ring *rx_ring,
 			       const int budget)
 {
@@ -1905,10 +2011,15 @@ static bool ixgbe_clean_rx_irq(struct ixgbe_q_vector *q_vector,
 	unsigned int mss = 0;
 #endif /* IXGBE_FCOE */
 	u16 cleaned_count = ixgbe_desc_unused(rx_ring);
+	struct sk_filter *xdp_prog;
+
+	rcu_read_lock();
+	xdp_prog = rcu_dereference(q_vector->adapter->xdp_prog);
 
 	do {
 		union ixgbe_adv_rx_desc *rx_desc;
 		struct sk_buff *skb;
+		u32 xdp_act = XDP_PASS;
 
 		/* return some buffers to hardware, one at a time is too slow */
 		if (cleaned_count >= IXGBE_RX_BUFFER_WRITE) {
@@ -1928,6 +2039,19 @@ static bool ixgbe_clean_rx_irq(struct ixgbe_q_vector *q_vector,
 		 */
 		rmb();
 
+		/* let the Rx program act on the frame before any skb exists */
+		if (xdp_prog) {
+			xdp_act = ixgbe_run_xdp(rx_ring, rx_desc, xdp_prog);
+			if (xdp_act != XDP_PASS && xdp_act != XDP_TX) {
+				total_rx_bytes +=
+					le16_to_cpu(rx_desc->wb.upper.length);
+				ixgbe_xdp_drop(rx_ring);
+				cleaned_count++;
+				total_rx_packets++;
+				continue;
+			}
+		}
+
 		/* retrieve a buffer from the ring */
 		skb = ixgbe_fetch_rx_buffer(rx_ring, rx_desc);
 
@@ -1951,6 +2075,12 @@ static bool ixgbe_clean_rx_irq(struct ixgbe_q_vector *q_vector,
 		/* populate checksum, timestamp, VLAN, and protocol */
 		ixgbe_process_skb_fields(rx_ring, rx_desc, skb);
 
+		if (xdp_act == XDP_TX) {
+			ixgbe_xdp_xmit(rx_ring, skb);
+			total_rx_packets++;
+			continue;
+		}
+
 #ifdef IXGBE_FCOE
 		/* if ddp, not passing to ULD unless for FCP_RSP or error */
 		if (ixgbe_rx_is_fcoe(rx_ring, rx_desc)) {
@@ -1982,6 +2112,8 @@ static bool ixgbe_clean_rx_irq(struct ixgbe_q_vector *q_vector,
 		total_rx_packets++;
 	} while (likely(total_rx_packets < budget));
 
+	rcu_read_unlock();
+
 	u64_stats_update_begin(&rx_ring->syncp);
 	rx_ring->stats.packets += total_rx_packets;
 	rx_ring->stats.bytes += total_rx_bytes;
@@ -1992,7 +2124,7 @@ static bool ixgbe_clean_rx_irq(struct ixgbe_q_vector *q_vector,
 	if (cleaned_count)
 		ixgbe_alloc_rx_buffers(rx_ring, cleaned_count);
 
-	return (total_rx_packets < budget);
+	return total_rx_packets;
 }
 
 /**
@@ -2557,9 +2689,15 @@ int ixgbe_poll(struct napi_struct *napi, int budget)
 	else
 		per_ring_budget = budget;
 
+	/* Exit if we are called by netpoll or busy polling is active */
+	if (!ixgbe_qv_lock_napi(q_vector))
+		return budget;
+
 	ixgbe_for_each_ring(ring, q_vector->rx)
-		clean_complete &= ixgbe_clean_rx_irq(q_vector, ring,
-						     per_ring_budget);
+		clean_complete &= (ixgbe_clean_rx_irq(q_vector, ring,
+				   per_ring_budget) < per_ring_budget);
+
+	ixgbe_qv_unlock_napi(q_vector);
 
 	/* If all work not completed, return budget and keep polling */
 	if (!clean_complete)
@@ -2575,6 +2713,41 @@ int ixgbe_poll(struct napi_struct *napi, int budget)
 	return 0;
 }
 
+#ifdef CONFIG_NET_RX_BUSY_POLL
+/**
+ * ixgbe_low_latency_recv - busy poll the Rx rings of a q_vector
+ * @napi: napi struct embedded in the q_vector to poll
+ *
+ * Called from the socket layer with bottom halves disabled.  Returns the
+ * number of packets cleaned, or LL_FLUSH_BUSY if NAPI currently owns the
+ * q_vector.
+ **/
+static int ixgbe_low_latency_recv(struct napi_struct *napi)
+{
+	struct ixgbe_q_vector *q_vector =
+			container_of(napi, struct ixgbe_q_vector, napi);
+	struct ixgbe_adapter *adapter = q_vector->adapter;
+	struct ixgbe_ring  *ring;
+	int found = 0;
+
+	if (test_bit(__IXGBE_DOWN, &adapter->state))
+		return LL_FLUSH_FAILED;
+
+	if (!ixgbe_qv_lock_poll(q_vector))
+		return LL_FLUSH_BUSY;
+
+	ixgbe_for_each_ring(ring, q_vector->rx) {
+		found = ixgbe_clean_rx_irq(q_vector, ring, 4);
+		if (found)
+			break;
+	}
+
+	ixgbe_qv_unlock_poll(q_vector);
+
+	return found;
+}
+#endif	/* CONFIG_NET_RX_BUSY_POLL */
+
 /**
  * ixgbe_request_msix_irqs - Initialize MSI-X interrupts
  * @adapter: board private structure
@@ -2606,6 +2779,11 @@ static int ixgbe_request_msix_irqs(struct ixgbe_adapter *adapter)
 			/* skip this unused q_vector */
 			continue;
 		}
+		/* Without a Flow Director cpu, spread vectors over the nodes */
+		if (cpumask_empty(&q_vector->affinity_mask))
+			irq_spread_affinity(entry->vector, vector,
+					    adapter->num_q_vectors,
+					    q_vector->numa_node);
 		err = request_irq(entry->vector, &ixgbe_msix_clean_rings, 0,
 				  q_vector->name, q_vector);
 		if (err) {
@@ -2842,6 +3020,7 @@ void ixgbe_configure_tx_ring(struct ixgbe_adapter *adapter,
 	IXGBE_WRITE_REG(hw, IXGBE_TDH(reg_idx), 0);
 	IXGBE_WRITE_REG(hw, IXGBE_TDT(reg_idx), 0);
 	ring->tail = hw->hw_addr + IXGBE_TDT(reg_idx);
+	ring->next_to_notify = 0;
 
 	/*
 	 * set WTHRESH to encourage burst writeback, it should not be set
@@ -3747,16 +3926,21 @@ static void ixgbe_napi_enable_all(struct ixgbe_adapter *adapter)
 {
 	int q_idx;
 
-	for (q_idx = 0; q_idx < adapter->num_q_vectors; q_idx++)
+	for (q_idx = 0; q_idx < adapter->num_q_vectors; q_idx++) {
+		ixgbe_qv_init_lock(adapter->q_vector[q_idx]);
 		napi_enable(&adapter->q_vector[q_idx]->napi);
+	}
 }
 
 static void ixgbe_napi_disable_all(struct ixgbe_adapter *adapter)
 {
 	int q_idx;
 
-	for (q_idx = 0; q_idx < adapter->num_q_vectors; q_idx++)
+	for (q_idx = 0; q_idx < adapter->num_q_vectors; q_idx++) {
 		napi_disable(&adapter->q_vector[q_idx]->napi);
+		while (!ixgbe_qv_disable(adapter->q_vector[q_idx]))
+			usleep_range(1000, 20000);
+	}
 }
 
 #ifdef CONFIG_IXGBE_DCB
@@ -4785,6 +4969,7 @@ err_setup_tx:
  **/
 int ixgbe_setup_rx_resources(struct ixgbe_ring *rx_ring)
 {
+	struct page_pool_params pp_params;
 	struct device *dev = rx_ring->dev;
 	int orig_node = dev_to_node(dev);
 	int numa_node = -1;
@@ -4795,12 +4980,31 @@ int ixgbe_setup_rx_resources(struct ixgbe_ring *rx_ring)
 	if (rx_ring->q_vector)
 		numa_node = rx_ring->q_vector->numa_node;
 
+	/* ixgbe_set_ringparam() passes a copy of a live ring: only free
+	 * on error what is allocated here, never the live ring's resources
+	 */
+	rx_ring->xdp_ctx = NULL;
+	rx_ring->page_pool = NULL;
+
 	rx_ring->rx_buffer_info = vzalloc_node(size, numa_node);
 	if (!rx_ring->rx_buffer_info)
 		rx_ring->rx_buffer_info = vzalloc(size);
 	if (!rx_ring->rx_buffer_info)
 		goto err;
 
+	rx_ring->xdp_ctx = sk_filter_frame_ctx_alloc(rx_ring->netdev,
+						     numa_node);
+	if (!rx_ring->xdp_ctx)
+		goto err;
+
+	pp_params.order = ixgbe_rx_pg_order(rx_ring);
+	pp_params.size = rx_ring->count;
+	pp_params.dev = dev;
+	pp_params.dma_dir = DMA_FROM_DEVICE;
+	rx_ring->page_pool = page_pool_create(&pp_params);
+	if (!rx_ring->page_pool)
+		goto err;
+
 	/* Round up to nearest 4K */
 	rx_ring->size = rx_ring->count * sizeof(union ixgbe_adv_rx_desc);
 	rx_ring->size = ALIGN(rx_ring->size, 4096);
@@ -4822,6 +5026,10 @@ int ixgbe_setup_rx_resources(struct ixgbe_ring *rx_ring)
 
 	return 0;
 err:
+	page_pool_destroy(rx_ring->page_pool);
+	rx_ring->page_pool = NULL;
+	kfree(rx_ring->xdp_ctx);
+	rx_ring->xdp_ctx = NULL;
 	vfree(rx_ring->rx_buffer_info);
 	rx_ring->rx_buffer_info = NULL;
 	dev_err(dev, "Unable to allocate memory for the Rx descriptor ring\n");
@@ -4911,6 +5119,12 @@ void ixgbe_free_rx_resources(struct ixgbe_ring *rx_ring)
 {
 	ixgbe_clean_rx_ring(rx_ring);
 
+	page_pool_destroy(rx_ring->page_pool);
+	rx_ring->page_pool = NULL;
+
+	kfree(rx_ring->xdp_ctx);
+	rx_ring->xdp_ctx = NULL;
+
 	vfree(rx_ring->rx_buffer_info);
 	rx_ring->rx_buffer_info = NULL;
 
@@ -5247,6 +5461,7 @@ void ixgbe_update_stats(struct ixgbe_adapter *adapter)
 	u64 non_eop_descs = 0, restart_queue = 0, tx_busy = 0;
 	u64 alloc_rx_page_failed = 0, alloc_rx_buff_failed = 0;
 	u64 bytes = 0, packets = 0, hw_csum_rx_error = 0;
+	u64 xdp_drop = 0, xdp_tx = 0;
 
 	if (test_bit(__IXGBE_DOWN, &adapter->state) ||
 	    test_bit(__IXGBE_RESETTING, &adapter->state))
@@ -5269,6 +5484,8 @@ void ixgbe_update_stats(struct ixgbe_adapter *adapter)
 		alloc_rx_page_failed += rx_ring->rx_stats.alloc_rx_page_failed;
 		alloc_rx_buff_failed += rx_ring->rx_stats.alloc_rx_buff_failed;
 		hw_csum_rx_error += rx_ring->rx_stats.csum_err;
+		xdp_drop += rx_ring->rx_stats.xdp_drop;
+		xdp_tx += rx_ring->rx_stats.xdp_tx;
 		bytes += rx_ring->stats.bytes;
 		packets += rx_ring->stats.packets;
 	}
@@ -5276,6 +5493,8 @@ void ixgbe_update_stats(struct ixgbe_adapter *adapter)
 	adapter->alloc_rx_page_failed = alloc_rx_page_failed;
 	adapter->alloc_rx_buff_failed = alloc_rx_buff_failed;
 	adapter->hw_csum_rx_error = hw_csum_rx_error;
+	adapter->xdp_drop = xdp_drop;
+	adapter->xdp_tx = xdp_tx;
 	netdev->stats.rx_bytes = bytes;
 	netdev->stats.rx_packets = packets;
 
@@ -6192,6 +6411,47 @@ static void ixgbe_tx_olinfo_status(union ixgbe_adv_tx_desc *tx_desc,
 #define IXGBE_TXD_CMD (IXGBE_TXD_CMD_EOP | \
 		       IXGBE_TXD_CMD_RS)
 
+static int __ixgbe_maybe_stop_tx(struct ixgbe_ring *tx_ring, u16 size)
+{
+	netif_stop_subqueue(tx_ring->netdev, tx_ring->queue_index);
+	/* Herbert's original patch had:
+	 *  smp_mb__after_netif_stop_queue();
+	 * but since that doesn't exist yet, just open code it. */
+	smp_mb();
+
+	/* We need to check again in a case another CPU has just
+	 * made room available. */
+	if (likely(ixgbe_desc_unused(tx_ring) < size))
+		return -EBUSY;
+
+	/* A reprieve! - use start_queue because it doesn't call schedule */
+	netif_start_subqueue(tx_ring->netdev, tx_ring->queue_index);
+	++tx_ring->tx_stats.restart_queue;
+	return 0;
+}
+
+static inline int ixgbe_maybe_stop_tx(struct ixgbe_ring *tx_ring, u16 size)
+{
+	if (likely(ixgbe_desc_unused(tx_ring) >= size))
+		return 0;
+	return __ixgbe_maybe_stop_tx(tx_ring, size);
+}
+
+/* Let hardware fetch the descriptors queued since the last tail update.
+ * Dropped packets call this too, or a tail update held back under
+ * xmit_more for the rest of the batch would be lost with them.
+ */
+static void ixgbe_tx_notify(struct ixgbe_ring *tx_ring)
+{
+	u16 i = tx_ring->next_to_use;
+
+	if (i == tx_ring->next_to_notify)
+		return;
+
+	tx_ring->next_to_notify = i;
+	writel(i, tx_ring->tail);
+}
+
 static void ixgbe_tx_map(struct ixgbe_ring *tx_ring,
 			 struct ixgbe_tx_buffer *first,
 			 const u8 hdr_len)
@@ -6310,8 +6570,13 @@ static void ixgbe_tx_map(struct ixgbe_ring *tx_ring,
 
 	tx_ring->next_to_use = i;
 
-	/* notify HW of packet */
-	writel(i, tx_ring->tail);
+	ixgbe_maybe_stop_tx(tx_ring, DESC_NEEDED);
+
+	/* notify HW of packet, unless the stack has more on the way and
+	 * the queue is still open to take them
+	 */
+	if (netif_xmit_stopped(txring_txq(tx_ring)) || !first->skb->xmit_more)
+		ixgbe_tx_notify(tx_ring);
 
 	return;
 dma_error:
@@ -6329,6 +6594,8 @@ dma_error:
 	}
 
 	tx_ring->next_to_use = i;
+
+	ixgbe_tx_notify(tx_ring);
 }
 
 static void ixgbe_atr(struct ixgbe_ring *ring,
@@ -6419,32 +6686,6 @@ static void ixgbe_atr(struct ixgbe_ring *ring,
 					      input, common, ring->queue_index);
 }
 
-static int __ixgbe_maybe_stop_tx(struct ixgbe_ring *tx_ring, u16 size)
-{
-	netif_stop_subqueue(tx_ring->netdev, tx_ring->queue_index);
-	/* Herbert's original patch had:
-	 *  smp_mb__after_netif_stop_queue();
-	 * but since that doesn't exist yet, just open code it. */
-	smp_mb();
-
-	/* We need to check again in a case another CPU has just
-	 * made room available. */
-	if (likely(ixgbe_desc_unused(tx_ring) < size))
-		return -EBUSY;
-
-	/* A reprieve! - use start_queue because it doesn't call schedule */
-	netif_start_subqueue(tx_ring->netdev, tx_ring->queue_index);
-	++tx_ring->tx_stats.restart_queue;
-	return 0;
-}
-
-static inline int ixgbe_maybe_stop_tx(struct ixgbe_ring *tx_ring, u16 size)
-{
-	if (likely(ixgbe_desc_unused(tx_ring) >= size))
-		return 0;
-	return __ixgbe_maybe_stop_tx(tx_ring, size);
-}
-
 #ifdef IXGBE_FCOE
 static u16 ixgbe_select_queue(struct net_device *dev, struct sk_buff *skb)
 {
@@ -6503,6 +6744,7 @@ netdev_tx_t ixgbe_xmit_frame_ring(struct sk_buff *skb,
 
 	if (ixgbe_maybe_stop_tx(tx_ring, count + 3)) {
 		tx_ring->tx_stats.tx_busy++;
+		ixgbe_tx_notify(tx_ring);
 		return NETDEV_TX_BUSY;
 	}
 
@@ -6601,13 +6843,12 @@ xmit_fcoe:
 #endif /* IXGBE_FCOE */
 	ixgbe_tx_map(tx_ring, first, hdr_len);
 
-	ixgbe_maybe_stop_tx(tx_ring, DESC_NEEDED);
-
 	return NETDEV_TX_OK;
 
 out_drop:
 	dev_kfree_skb_any(first->skb);
 	first->skb = NULL;
+	ixgbe_tx_notify(tx_ring);
 
 	return NETDEV_TX_OK;
 }
@@ -7150,6 +7391,28 @@ static int ixgbe_ndo_bridge_getlink(struct sk_buff *skb, u32 pid, u32 seq,
 	return ndo_dflt_bridge_getlink(skb, pid, seq, dev, mode);
 }
 
+static int ixgbe_xdp(struct net_device *dev, struct netdev_xdp *xdp)
+{
+	struct ixgbe_adapter *adapter = netdev_priv(dev);
+	struct sk_filter *old_prog;
+
+	switch (xdp->command) {
+	case XDP_SETUP_PROG:
+		old_prog = rtnl_dereference(adapter->xdp_prog);
+		rcu_assign_pointer(adapter->xdp_prog, xdp->prog);
+
+		/* running polls hold rcu_read_lock, the release waits for them */
+		if (old_prog)
+			sk_unattached_filter_destroy(old_prog);
+		return 0;
+	case XDP_QUERY_PROG:
+		xdp->prog_attached = !!rtnl_dereference(adapter->xdp_prog);
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
 static const struct net_device_ops ixgbe_netdev_ops = {
 	.ndo_open		= ixgbe_open,
 	.ndo_stop		= ixgbe_close,
@@ -7177,6 +7440,9 @@ static const struct net_device_ops ixgbe_netdev_ops = {
 #ifdef CONFIG_NET_POLL_CONTROLLER
 	.ndo_poll_controller	= ixgbe_netpoll,
 #endif
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	.ndo_busy_poll		= ixgbe_low_latency_recv,
+#endif
 #ifdef IXGBE_FCOE
 	.ndo_fcoe_ddp_setup = ixgbe_fcoe_ddp_get,
 	.ndo_fcoe_ddp_target = ixgbe_fcoe_ddp_target,
@@ -7191,6 +7457,7 @@ static const struct net_device_ops ixgbe_netdev_ops = {
 	.ndo_fdb_add		= ixgbe_ndo_fdb_add,
 	.ndo_bridge_setlink	= ixgbe_ndo_bridge_setlink,
 	.ndo_bridge_getlink	= ixgbe_ndo_bridge_getlink,
+	.ndo_xdp		= ixgbe_xdp,
 };
 
 /**
@@ -7691,6 +7958,7 @@ static void ixgbe_remove(struct pci_dev *pdev)
 {
 	struct ixgbe_adapter *adapter = pci_get_drvdata(pdev);
 	struct net_device *netdev = adapter->netdev;
+	struct sk_filter *xdp_prog;
 
 	ixgbe_dbg_adapter_exit(adapter);
 
@@ -7716,6 +7984,11 @@ static void ixgbe_remove(struct pci_dev *pdev)
 	if (netdev->reg_state == NETREG_REGISTERED)
 		unregister_netdev(netdev);
 
+	/* the device is down, no poll can still be running the Rx program */
+	xdp_prog = rcu_dereference_protected(adapter->xdp_prog, 1);
+	if (xdp_prog)
+		sk_unattached_filter_destroy(xdp_prog);
+
 #ifdef CONFIG_PCI_IOV
 	/*
 	 * Only disable SR-IOV on unload if the user specified the now
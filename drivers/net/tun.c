@@ -140,6 +140,12 @@ struct tun_file {
 	u16 queue_index;
 	struct list_head next;
 	struct tun_struct *detached;
+	/* packets written by userspace are fed to the stack from this NAPI
+	 * context when the device was created with IFF_NAPI, they are
+	 * queued on sk_write_queue in the meantime.
+	 */
+	struct napi_struct napi;
+	bool napi_enabled;
 };
 
 struct tun_flow_entry {
@@ -405,6 +411,60 @@ static struct tun_struct *tun_enable_queue(struct tun_file *tfile)
 	return tun;
 }
 
+static int tun_napi_poll(struct napi_struct *napi, int budget)
+{
+	struct tun_file *tfile = container_of(napi, struct tun_file, napi);
+	struct sk_buff_head *queue = &tfile->sk.sk_write_queue;
+	struct sk_buff_head process_queue;
+	struct sk_buff *skb;
+	int received = 0;
+
+	__skb_queue_head_init(&process_queue);
+
+	spin_lock(&queue->lock);
+	skb_queue_splice_tail_init(queue, &process_queue);
+	spin_unlock(&queue->lock);
+
+	while (received < budget && (skb = __skb_dequeue(&process_queue))) {
+		napi_gro_receive(napi, skb);
+		++received;
+	}
+
+	if (!skb_queue_empty(&process_queue)) {
+		spin_lock(&queue->lock);
+		skb_queue_splice(&process_queue, queue);
+		spin_unlock(&queue->lock);
+	}
+
+	if (received < budget) {
+		napi_complete(napi);
+		/* The writer could not schedule us while we were running */
+		if (!skb_queue_empty(queue))
+			napi_schedule(napi);
+	}
+
+	return received;
+}
+
+static void tun_napi_init(struct tun_struct *tun, struct tun_file *tfile)
+{
+	if (tun->flags & TUN_NAPI) {
+		netif_napi_add(tun->dev, &tfile->napi, tun_napi_poll,
+			       NAPI_POLL_WEIGHT);
+		napi_enable(&tfile->napi);
+		tfile->napi_enabled = true;
+	}
+}
+
+static void tun_napi_del(struct tun_file *tfile)
+{
+	if (tfile->napi_enabled) {
+		tfile->napi_enabled = false;
+		napi_disable(&tfile->napi);
+		netif_napi_del(&tfile->napi);
+	}
+}
+
 static void __tun_detach(struct tun_file *tfile, bool clean)
 {
 	struct tun_file *ntfile;
@@ -429,9 +489,11 @@ static void __tun_detach(struct tun_file *tfile, bool clean)
 			tun_disable_queue(tun, tfile);
 
 		synchronize_net();
+		tun_napi_del(tfile);
 		tun_flow_delete_by_queue(tun, tun->numqueues + 1);
 		/* Drop read queue */
 		skb_queue_purge(&tfile->sk.sk_receive_queue);
+		skb_queue_purge(&tfile->sk.sk_write_queue);
 		tun_set_real_num_queues(tun);
 	} else if (tfile->detached && clean) {
 		tun = tun_enable_queue(tfile);
@@ -482,13 +544,16 @@ static void tun_detach_all(struct net_device *dev)
 	synchronize_net();
 	for (i = 0; i < n; i++) {
 		tfile = rtnl_dereference(tun->tfiles[i]);
+		tun_napi_del(tfile);
 		/* Drop read queue */
 		skb_queue_purge(&tfile->sk.sk_receive_queue);
+		skb_queue_purge(&tfile->sk.sk_write_queue);
 		sock_put(&tfile->sk);
 	}
 	list_for_each_entry_safe(tfile, tmp, &tun->disabled, next) {
 		tun_enable_queue(tfile);
 		skb_queue_purge(&tfile->sk.sk_receive_queue);
+		skb_queue_purge(&tfile->sk.sk_write_queue);
 		sock_put(&tfile->sk);
 	}
 	BUG_ON(tun->numdisabled != 0);
@@ -537,6 +602,7 @@ static int tun_attach(struct tun_struct *tun, struct file *file)
 	else
 		sock_hold(&tfile->sk);
 
+	tun_napi_init(tun, tfile);
 	tun_set_real_num_queues(tun);
 
 	/* device is allowed to go away first, so no need to hold extra
@@ -741,7 +807,7 @@ static netdev_tx_t tun_net_xmit(struct sk_buff *skb, struct net_device *dev)
 
 	/* Orphan the skb - required as we might hang on to it
 	 * for indefinite time. */
-	if (unlikely(skb_orphan_frags(skb, GFP_ATOMIC)))
+	if (unlikely(skb_orphan_frags_rx(skb, GFP_ATOMIC)))
 		goto drop;
 	skb_orphan(skb);
 
@@ -1063,7 +1129,8 @@ static unsigned long iov_pages(const struct iovec *iv, int offset,
 /* Get packet from user space buffer */
 static ssize_t tun_get_user(struct tun_struct *tun, struct tun_file *tfile,
 			    void *msg_control, const struct iovec *iv,
-			    size_t total_len, size_t count, int noblock)
+			    size_t total_len, size_t count, int noblock,
+			    bool more)
 {
 	struct tun_pi pi = { 0, cpu_to_be16(ETH_P_IP) };
 	struct sk_buff *skb;
@@ -1227,7 +1294,25 @@ static ssize_t tun_get_user(struct tun_struct *tun, struct tun_file *tfile,
 	skb_probe_transport_header(skb, 0);
 
 	rxhash = skb_get_rxhash(skb);
-	netif_rx_ni(skb);
+
+	/* Zerocopy frags must not be merged by GRO into an skb that
+	 * outlives the ubuf_info callback, so they bypass NAPI.
+	 */
+	if (tfile->napi_enabled && !zerocopy) {
+		struct sk_buff_head *queue = &tfile->sk.sk_write_queue;
+		int queue_len;
+
+		spin_lock_bh(&queue->lock);
+		__skb_queue_tail(queue, skb);
+		queue_len = skb_queue_len(queue);
+		spin_unlock(&queue->lock);
+
+		if (!more || queue_len > NAPI_POLL_WEIGHT)
+			napi_schedule(&tfile->napi);
+
+		local_bh_enable();
+	} else
+		netif_rx_ni(skb);
 
 	tun->dev->stats.rx_packets++;
 	tun->dev->stats.rx_bytes += len;
@@ -1250,7 +1335,7 @@ static ssize_t tun_chr_aio_write(struct kiocb *iocb, const struct iovec *iv,
 	tun_debug(KERN_INFO, tun, "tun_chr_write %ld\n", count);
 
 	result = tun_get_user(tun, tfile, NULL, iv, iov_length(iv, count),
-			      count, file->f_flags & O_NONBLOCK);
+			      count, file->f_flags & O_NONBLOCK, false);
 
 	tun_put(tun);
 	return result;
@@ -1475,7 +1560,8 @@ static int tun_sendmsg(struct kiocb *iocb, struct socket *sock,
 	if (!tun)
 		return -EBADFD;
 	ret = tun_get_user(tun, tfile, m->msg_control, m->msg_iov, total_len,
-			   m->msg_iovlen, m->msg_flags & MSG_DONTWAIT);
+			   m->msg_iovlen, m->msg_flags & MSG_DONTWAIT,
+			   m->msg_flags & MSG_MORE);
 	tun_put(tun);
 	return ret;
 }
@@ -1551,6 +1637,9 @@ static int tun_flags(struct tun_struct *tun)
 	if (tun->flags & TUN_TAP_MQ)
 		flags |= IFF_MULTI_QUEUE;
 
+	if (tun->flags & TUN_NAPI)
+		flags |= IFF_NAPI;
+
 	return flags;
 }
 
@@ -1610,6 +1699,9 @@ static int tun_set_iff(struct net *net, struct file *file, struct ifreq *ifr)
 		    !!(tun->flags & TUN_TAP_MQ))
 			return -EINVAL;
 
+		if (!!(ifr->ifr_flags & IFF_NAPI) != !!(tun->flags & TUN_NAPI))
+			return -EINVAL;
+
 		if (tun_not_capable(tun))
 			return -EPERM;
 		err = security_tun_dev_open(tun->security);
@@ -1652,6 +1744,9 @@ static int tun_set_iff(struct net *net, struct file *file, struct ifreq *ifr)
 		} else
 			return -EINVAL;
 
+		if (ifr->ifr_flags & IFF_NAPI)
+			flags |= TUN_NAPI;
+
 		if (*ifr->ifr_name)
 			name = ifr->ifr_name;
 
@@ -1875,6 +1970,79 @@ unlock:
 	return ret;
 }
 
+/* Move up to tun_pkts.count packets in one call. Only the first packet
+ * honours a blocking file, the rest of the batch stops at the first packet
+ * that is not immediately available (or cannot be queued). Returns the
+ * number of packets transferred, or the error of the first packet.
+ */
+static long tun_xfer_pkts(struct file *file, unsigned int cmd,
+			  void __user *argp)
+{
+	struct tun_file *tfile = file->private_data;
+	struct tun_pkt __user *upkt;
+	struct tun_struct *tun;
+	struct tun_pkts pkts;
+	struct tun_pkt pkt;
+	struct iovec iov;
+	int noblock = file->f_flags & O_NONBLOCK;
+	ssize_t ret = 0;
+	unsigned int i;
+
+	if (copy_from_user(&pkts, argp, sizeof(pkts)))
+		return -EFAULT;
+	if (pkts.flags || pkts.count > UIO_MAXIOV)
+		return -EINVAL;
+	upkt = (struct tun_pkt __user *)(unsigned long)pkts.pkts;
+
+	tun = __tun_get(tfile);
+	if (!tun)
+		return -EBADFD;
+
+	for (i = 0; i < pkts.count; i++) {
+		if (copy_from_user(&pkt, &upkt[i], sizeof(pkt))) {
+			ret = -EFAULT;
+			break;
+		}
+		iov.iov_base = (void __user *)(unsigned long)pkt.buf;
+		iov.iov_len = pkt.len;
+
+		if (cmd == TUNSENDPKTS) {
+			ret = tun_get_user(tun, tfile, NULL, &iov, pkt.len, 1,
+					   noblock, i + 1 < pkts.count);
+			if (ret < 0)
+				break;
+			pkt.flags = 0;
+		} else {
+			ret = tun_do_read(tun, tfile, NULL, &iov, pkt.len,
+					  noblock);
+			if (ret < 0)
+				break;
+			pkt.flags = ret > pkt.len ? TUN_PKT_STRIP : 0;
+			ret = min_t(ssize_t, ret, pkt.len);
+		}
+
+		pkt.len = ret;
+		if (copy_to_user(&upkt[i], &pkt, sizeof(pkt))) {
+			ret = -EFAULT;
+			break;
+		}
+		noblock = 1;
+	}
+
+	/* Packets queued ahead of a failed one still have to be delivered */
+	if (cmd == TUNSENDPKTS && tfile->napi_enabled) {
+		local_bh_disable();
+		if (!skb_queue_empty(&tfile->sk.sk_write_queue))
+			napi_schedule(&tfile->napi);
+		local_bh_enable();
+	}
+
+	tun_put(tun);
+	if (i)
+		return i;
+	return ret;
+}
+
 static long __tun_chr_ioctl(struct file *file, unsigned int cmd,
 			    unsigned long arg, int ifreq_len)
 {
@@ -1905,10 +2073,12 @@ static long __tun_chr_ioctl(struct file *file, unsigned int cmd,
 		 * This is needed because we never checked for invalid flags on
 		 * TUNSETIFF. */
 		return put_user(IFF_TUN | IFF_TAP | IFF_NO_PI | IFF_ONE_QUEUE |
-				IFF_VNET_HDR | IFF_MULTI_QUEUE,
+				IFF_VNET_HDR | IFF_MULTI_QUEUE | IFF_NAPI,
 				(unsigned int __user*)argp);
 	} else if (cmd == TUNSETQUEUE)
 		return tun_set_queue(file, &ifr);
+	else if (cmd == TUNSENDPKTS || cmd == TUNRECVPKTS)
+		return tun_xfer_pkts(file, cmd, argp);
 
 	ret = 0;
 	rtnl_lock();
@@ -2122,6 +2292,8 @@ static long tun_chr_compat_ioctl(struct file *file,
 	case TUNSETTXFILTER:
 	case TUNGETSNDBUF:
 	case TUNSETSNDBUF:
+	case TUNSENDPKTS:
+	case TUNRECVPKTS:
 	case SIOCGIFHWADDR:
 	case SIOCSIFHWADDR:
 		arg = (unsigned long)compat_ptr(arg);
@@ -27,6 +27,7 @@
 #include <linux/if_vlan.h>
 #include <linux/slab.h>
 #include <linux/cpu.h>
+#include <net/page_pool.h>
 
 static int napi_weight = NAPI_POLL_WEIGHT;
 module_param(napi_weight, int, 0444);
@@ -76,6 +77,9 @@ struct receive_queue {
 	/* Chain pages by the private ptr. */
 	struct page *pages;
 
+	/* Pages passed up the stack, reused once the skbs are freed. */
+	struct page_pool *page_pool;
+
 	/* RX: fragments + linear part + virtio header */
 	struct scatterlist sg[MAX_SKB_FRAGS + 2];
 
@@ -198,8 +202,12 @@ static struct page *get_a_page(struct receive_queue *rq, gfp_t gfp_mask)
 		rq->pages = (struct page *)p->private;
 		/* clear private here, it is used to chain pages */
 		p->private = 0;
-	} else
-		p = alloc_page(gfp_mask);
+	} else {
+		p = page_pool_alloc_pages(rq->page_pool, gfp_mask, NULL);
+		/* a recycled page may still carry a chain pointer */
+		if (p)
+			p->private = 0;
+	}
 	return p;
 }
 
@@ -214,8 +222,9 @@ static void skb_xmit_done(struct virtqueue *vq)
 	netif_wake_subqueue(vi->dev, vq2txq(vq));
 }
 
-static void set_skb_frag(struct sk_buff *skb, struct page *page,
-			 unsigned int offset, unsigned int *len)
+static void set_skb_frag(struct receive_queue *rq, struct sk_buff *skb,
+			 struct page *page, unsigned int offset,
+			 unsigned int *len)
 {
 	int size = min((unsigned)PAGE_SIZE - offset, *len);
 	int i = skb_shinfo(skb)->nr_frags;
@@ -228,6 +237,8 @@ static void set_skb_frag(struct sk_buff *skb, struct page *page,
 	skb_shinfo(skb)->nr_frags++;
 	skb_shinfo(skb)->tx_flags |= SKBTX_SHARED_FRAG;
 	*len -= size;
+
+	page_pool_recycle(rq->page_pool, page, 0);
 }
 
 /* Called from bottom half context */
@@ -283,7 +294,7 @@ static struct sk_buff *page_to_skb(struct receive_queue *rq,
 	}
 
 	while (len) {
-		set_skb_frag(skb, page, offset, &len);
+		set_skb_frag(rq, skb, page, offset, &len);
 		page = (struct page *)page->private;
 		offset = 0;
 	}
@@ -319,7 +330,7 @@ static int receive_mergeable(struct receive_queue *rq, struct sk_buff *skb)
 		if (len > PAGE_SIZE)
 			len = PAGE_SIZE;
 
-		set_skb_frag(skb, page, 0, &len);
+		set_skb_frag(rq, skb, page, 0, &len);
 
 		--rq->num;
 	}
@@ -720,6 +731,8 @@ static netdev_tx_t start_xmit(struct sk_buff *skb, struct net_device *dev)
 	struct virtnet_info *vi = netdev_priv(dev);
 	int qnum = skb_get_queue_mapping(skb);
 	struct send_queue *sq = &vi->sq[qnum];
+	struct netdev_queue *txq = netdev_get_tx_queue(dev, qnum);
+	bool kick = !skb->xmit_more;
 	int err;
 
 	/* Free up any pending old buffers before queueing new ones. */
@@ -736,9 +749,11 @@ static netdev_tx_t start_xmit(struct sk_buff *skb, struct net_device *dev)
 				 "Unexpected TXQ (%d) queue failure: %d\n", qnum, err);
 		dev->stats.tx_dropped++;
 		kfree_skb(skb);
+		/* earlier buffers may still be waiting for their kick */
+		if (kick)
+			virtqueue_kick(sq->vq);
 		return NETDEV_TX_OK;
 	}
-	virtqueue_kick(sq->vq);
 
 	/* Don't wait up for transmitted skbs to be freed. */
 	skb_orphan(skb);
@@ -758,6 +773,12 @@ static netdev_tx_t start_xmit(struct sk_buff *skb, struct net_device *dev)
 		}
 	}
 
+	/* Batch the notification while the stack has more packets for us,
+	 * a stopped queue will not hand them over so kick now then.
+	 */
+	if (kick || netif_xmit_stopped(txq))
+		virtqueue_kick(sq->vq);
+
 	return NETDEV_TX_OK;
 }
 
@@ -1285,6 +1306,11 @@ static void virtnet_config_changed(struct virtio_device *vdev)
 
 static void virtnet_free_queues(struct virtnet_info *vi)
 {
+	int i;
+
+	for (i = 0; i < vi->max_queue_pairs; i++)
+		page_pool_destroy(vi->rq[i].page_pool);
+
 	kfree(vi->rq);
 	kfree(vi->sq);
 }
@@ -1438,6 +1464,27 @@ err_sq:
 	return -ENOMEM;
 }
 
+/* Big and mergeable buffers are built from pages, keep as many as the
+ * receive ring holds.
+ */
+static int virtnet_alloc_page_pools(struct virtnet_info *vi)
+{
+	struct page_pool_params pp_params = { .order = 0 };
+	int i;
+
+	if (!vi->mergeable_rx_bufs && !vi->big_packets)
+		return 0;
+
+	for (i = 0; i < vi->max_queue_pairs; i++) {
+		pp_params.size = virtqueue_get_vring_size(vi->rq[i].vq);
+		vi->rq[i].page_pool = page_pool_create(&pp_params);
+		if (!vi->rq[i].page_pool)
+			return -ENOMEM;
+	}
+
+	return 0;
+}
+
 static int init_vqs(struct virtnet_info *vi)
 {
 	int ret;
@@ -1451,12 +1498,18 @@ static int init_vqs(struct virtnet_info *vi)
 	if (ret)
 		goto err_free;
 
+	ret = virtnet_alloc_page_pools(vi);
+	if (ret)
+		goto err_del;
+
 	get_online_cpus();
 	virtnet_set_affinity(vi);
 	put_online_cpus();
 
 	return 0;
 
+err_del:
+	vi->vdev->config->del_vqs(vi->vdev);
 err_free:
 	virtnet_free_queues(vi);
 err:
@@ -747,9 +747,16 @@ static int vxlan_udp_encap_recv(struct sock *sk, struct sk_buff *skb)
 	 * CHECKSUM_UNNECESSARY and Rx checksum feature is enabled,
 	 * leave the CHECKSUM_UNNECESSARY, the device checksummed it
 	 * for us. Otherwise force the upper layers to verify it.
+	 *
+	 * Packets merged by GRO had their inner checksums verified then,
+	 * by the NIC or by the inner protocol, as udp4_gro_receive() does
+	 * not trust the outer checksum for them. They only lose the tunnel
+	 * part of their GSO type.
 	 */
-	if (skb->ip_summed != CHECKSUM_UNNECESSARY || !skb->encapsulation ||
-	    !(vxlan->dev->features & NETIF_F_RXCSUM))
+	if (skb_is_gso(skb))
+		skb_shinfo(skb)->gso_type &= ~SKB_GSO_UDP_TUNNEL;
+	else if (skb->ip_summed != CHECKSUM_UNNECESSARY || !skb->encapsulation ||
+		 !(vxlan->dev->features & NETIF_F_RXCSUM))
 		skb->ip_summed = CHECKSUM_NONE;
 
 	skb->encapsulation = 0;
@@ -786,6 +793,70 @@ drop:
 	return 0;
 }
 
+static struct sk_buff **vxlan_gro_receive(struct sk_buff **head,
+					  struct sk_buff *skb)
+{
+	struct sk_buff **pp = NULL;
+	struct vxlanhdr *vxh, *vxh2;
+	unsigned int hlen, off;
+	struct sk_buff *p;
+	int flush = 1;
+	__wsum csum;
+
+	off = skb_gro_offset(skb);
+	hlen = off + sizeof(*vxh);
+	vxh = skb_gro_header_fast(skb, off);
+	if (skb_gro_header_hard(skb, hlen)) {
+		vxh = skb_gro_header_slow(skb, hlen, off);
+		if (unlikely(!vxh))
+			goto out;
+	}
+
+	/* leave packets vxlan_udp_encap_recv() would drop alone */
+	if (vxh->vx_flags != htonl(VXLAN_FLAGS) ||
+	    (vxh->vx_vni & htonl(0xff)))
+		goto out;
+
+	flush = 0;
+
+	for (p = *head; p; p = p->next) {
+		if (!NAPI_GRO_CB(p)->same_flow)
+			continue;
+
+		vxh2 = (struct vxlanhdr *)(p->data + off);
+		if (vxh->vx_vni != vxh2->vx_vni) {
+			NAPI_GRO_CB(p)->same_flow = 0;
+			continue;
+		}
+	}
+
+	skb_gro_pull(skb, sizeof(*vxh));
+
+	csum = skb->csum;
+	skb_postpull_rcsum(skb, vxh, sizeof(*vxh));
+
+	pp = eth_gro_receive(head, skb);
+
+	skb->csum = csum;
+out:
+	NAPI_GRO_CB(skb)->flush |= flush;
+
+	return pp;
+}
+
+static int vxlan_gro_complete(struct sk_buff *skb, int nhoff)
+{
+	return eth_gro_complete(skb, nhoff + sizeof(struct vxlanhdr));
+}
+
+/* Port filled in at module load, all namespaces share vxlan_port */
+static struct udp_offload vxlan_udp_offload = {
+	.callbacks = {
+		.gro_receive	= vxlan_gro_receive,
+		.gro_complete	= vxlan_gro_complete,
+	},
+};
+
 static int arp_reduce(struct net_device *dev, struct sk_buff *skb)
 {
 	struct vxlan_dev *vxlan = netdev_priv(dev);
@@ -1678,6 +1749,9 @@ static int __init vxlan_init_module(void)
 	if (rc)
 		goto out2;
 
+	vxlan_udp_offload.port = htons(vxlan_port);
+	udp_add_offload(&vxlan_udp_offload);
+
 	return 0;
 
 out2:
@@ -1689,6 +1763,7 @@ module_init(vxlan_init_module);
 
 static void __exit vxlan_cleanup_module(void)
 {
+	udp_del_offload(&vxlan_udp_offload);
 	rtnl_link_unregister(&vxlan_link_ops);
 	unregister_pernet_device(&vxlan_net_ops);
 	rcu_barrier();
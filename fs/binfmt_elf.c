@@ -363,6 +363,30 @@ static unsigned long elf_map(struct file *filep, unsigned long addr,
 
 #endif /* !elf_map */
 
+/*
+ * Map the part of a text segment that is already in the page cache up
+ * front, so that running a hot binary does not take a minor fault for
+ * every page of its text. map_cached_pages() bounds how much of a large
+ * segment this covers.
+ */
+static void elf_prefault_text(unsigned long map_addr, struct elf_phdr *eppnt)
+{
+	unsigned long size = eppnt->p_filesz + ELF_PAGEOFFSET(eppnt->p_vaddr);
+	struct mm_struct *mm = current->mm;
+	struct vm_area_struct *vma;
+
+	size = ELF_PAGEALIGN(size);
+	if (!(eppnt->p_flags & PF_X) || !size)
+		return;
+
+	down_read(&mm->mmap_sem);
+	vma = find_vma(mm, map_addr);
+	if (vma && vma->vm_start <= map_addr)
+		map_cached_pages(vma, map_addr,
+				 min(map_addr + size, vma->vm_end));
+	up_read(&mm->mmap_sem);
+}
+
 static unsigned long total_mapping_size(struct elf_phdr *cmds, int nr)
 {
 	int i, first_idx = -1, last_idx = -1;
@@ -470,6 +494,7 @@ static unsigned long load_elf_interp(struct elfhdr *interp_elf_ex,
 			error = map_addr;
 			if (BAD_ADDR(map_addr))
 				goto out_close;
+			elf_prefault_text(map_addr, eppnt);
 
 			if (!load_addr_set &&
 			    interp_elf_ex->e_type == ET_DYN) {
@@ -829,6 +854,7 @@ static int load_elf_binary(struct linux_binprm *bprm)
 				PTR_ERR((void*)error) : -EINVAL;
 			goto out_free_dentry;
 		}
+		elf_prefault_text(error, elf_ppnt);
 
 		if (!load_addr_set) {
 			load_addr_set = 1;
@@ -245,6 +245,11 @@ extern int irq_select_affinity(unsigned int irq);
 
 extern int irq_set_affinity_hint(unsigned int irq, const struct cpumask *m);
 
+extern void irq_spread_affinity_mask(unsigned int vec, unsigned int nvec,
+				     int node, struct cpumask *mask);
+extern int irq_spread_affinity(unsigned int irq, unsigned int vec,
+			       unsigned int nvec, int node);
+
 /**
  * struct irq_affinity_notify - context for notification of IRQ affinity changes
  * @irq:		Interrupt to which notification applies
@@ -287,6 +292,19 @@ static inline int irq_set_affinity_hint(unsigned int irq,
 {
 	return -EINVAL;
 }
+
+static inline void irq_spread_affinity_mask(unsigned int vec,
+					    unsigned int nvec, int node,
+					    struct cpumask *mask)
+{
+	cpumask_copy(mask, cpu_online_mask);
+}
+
+static inline int irq_spread_affinity(unsigned int irq, unsigned int vec,
+				      unsigned int nvec, int node)
+{
+	return -EINVAL;
+}
 #endif /* CONFIG_SMP && CONFIG_GENERIC_HARDIRQS */
 
 #ifdef CONFIG_GENERIC_HARDIRQS
@@ -186,6 +186,10 @@ struct vm_fault {
 					 * is set (which is also implied by
 					 * VM_FAULT_ERROR).
 					 */
+	/* for ->map_pages() only */
+	pgoff_t max_pgoff;		/* map pages for offset from pgoff till
+					 * max_pgoff inclusive */
+	pte_t *pte;			/* pte entry associated with ->pgoff */
 };
 
 /*
@@ -198,6 +202,14 @@ struct vm_operations_struct {
 	void (*close)(struct vm_area_struct * area);
 	int (*fault)(struct vm_area_struct *vma, struct vm_fault *vmf);
 
+	/*
+	 * Map the pages from vmf->pgoff to vmf->max_pgoff that are already
+	 * uptodate in the page cache, starting at vmf->pte. Called with the
+	 * pte lock held on read faults and at exec time, so it must not
+	 * sleep and must leave populated ptes alone.
+	 */
+	void (*map_pages)(struct vm_area_struct *vma, struct vm_fault *vmf);
+
 	/* notification that a previously read-only page is about to become
 	 * writable, if an error is returned it will cause a SIGBUS */
 	int (*page_mkwrite)(struct vm_area_struct *vma, struct vm_fault *vmf);
@@ -1002,6 +1014,10 @@ extern int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 			unsigned long address, unsigned int flags);
 extern int fixup_user_fault(struct task_struct *tsk, struct mm_struct *mm,
 			    unsigned long address, unsigned int fault_flags);
+extern void do_set_pte(struct vm_area_struct *vma, unsigned long address,
+			struct page *page, pte_t *pte);
+extern void map_cached_pages(struct vm_area_struct *vma,
+			unsigned long start, unsigned long end);
 #else
 static inline int handle_mm_fault(struct mm_struct *mm,
 			struct vm_area_struct *vma, unsigned long address,
@@ -1260,6 +1276,9 @@ static inline pmd_t *pmd_alloc(struct mm_struct *mm, pud_t *pud, unsigned long a
 static inline void pgtable_page_ctor(struct page *page)
 {
 	pte_lock_init(page);
+#ifdef CONFIG_FORK_SHARE_PTE
+	page->pt_share_count = 0;
+#endif
 	inc_zone_page_state(page, NR_PAGETABLE);
 }
 
@@ -1297,6 +1316,48 @@ static inline void pgtable_page_dtor(struct page *page)
 	((unlikely(pmd_none(*(pmd))) && __pte_alloc_kernel(pmd, address))? \
 		NULL: pte_offset_kernel(pmd, address))
 
+#ifdef CONFIG_FORK_SHARE_PTE
+extern int sysctl_fork_share_pte;
+
+/*
+ * A pte page mapped by more than one mm was shared by fork. The count of
+ * the other mms only changes under the lock of the table, see
+ * pte_share_lockptr(), so this is a hint unless that is held.
+ */
+static inline bool pte_table_shared(pmd_t *pmd)
+{
+	pmd_t pmdval = *pmd;
+
+	barrier();
+	if (pmd_none(pmdval) || pmd_trans_huge(pmdval))
+		return false;
+	return ACCESS_ONCE(pmd_page(pmdval)->pt_share_count) != 0;
+}
+
+extern int unshare_pte_table(struct mm_struct *mm, struct vm_area_struct *vma,
+			     pmd_t *pmd, unsigned long address);
+extern int unshare_pte_tables(struct vm_area_struct *vma,
+			      unsigned long start, unsigned long end);
+#else
+static inline bool pte_table_shared(pmd_t *pmd)
+{
+	return false;
+}
+
+static inline int unshare_pte_table(struct mm_struct *mm,
+				    struct vm_area_struct *vma,
+				    pmd_t *pmd, unsigned long address)
+{
+	return 0;
+}
+
+static inline int unshare_pte_tables(struct vm_area_struct *vma,
+				     unsigned long start, unsigned long end)
+{
+	return 0;
+}
+#endif /* CONFIG_FORK_SHARE_PTE */
+
 extern void free_area_init(unsigned long * zones_size);
 extern void free_area_init_node(int nid, unsigned long * zones_size,
 		unsigned long zone_start_pfn, unsigned long *zholes_size);
@@ -1576,6 +1637,7 @@ extern void truncate_inode_pages_range(struct address_space *,
 
 /* generic vm_area_ops exported for stackable file systems */
 extern int filemap_fault(struct vm_area_struct *, struct vm_fault *);
+extern void filemap_map_pages(struct vm_area_struct *vma, struct vm_fault *vmf);
 extern int filemap_page_mkwrite(struct vm_area_struct *vma, struct vm_fault *vmf);
 
 /* mm/page-writeback.c */
@@ -54,6 +54,10 @@ struct page {
 		union {
 			pgoff_t index;		/* Our offset within mapping. */
 			void *freelist;		/* slub/slob first free object */
+#ifdef CONFIG_FORK_SHARE_PTE
+			unsigned long pt_share_count;	/* pte page: other mms
+							 * fork let map it */
+#endif
 			bool pfmemalloc;	/* If set by the page allocator,
 						 * ALLOC_NO_WATERMARKS was set
 						 * and the low watermark was not
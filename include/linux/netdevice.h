@@ -52,6 +52,7 @@
 #include <uapi/linux/netdevice.h>
 
 struct netpoll_info;
+struct sk_filter;
 struct device;
 struct phy_device;
 /* 802.11 specific */
@@ -324,12 +325,15 @@ struct napi_struct {
 	struct sk_buff		*gro_list;
 	struct sk_buff		*skb;
 	struct list_head	dev_list;
+	struct hlist_node	napi_hash_node;
+	unsigned int		napi_id;
 };
 
 enum {
 	NAPI_STATE_SCHED,	/* Poll is scheduled */
 	NAPI_STATE_DISABLE,	/* Disable pending */
 	NAPI_STATE_NPSVC,	/* Netpoll - don't dequeue from poll_list */
+	NAPI_STATE_HASHED,	/* In NAPI hash */
 };
 
 enum gro_result {
@@ -445,6 +449,32 @@ static inline bool napi_reschedule(struct napi_struct *napi)
 extern void __napi_complete(struct napi_struct *n);
 extern void napi_complete(struct napi_struct *n);
 
+/**
+ *	napi_by_id - lookup a NAPI by napi_id
+ *	@napi_id: hashed napi_id
+ *
+ * lookup @napi_id in napi_hash table
+ * must be called under rcu_read_lock()
+ */
+extern struct napi_struct *napi_by_id(unsigned int napi_id);
+
+/**
+ *	napi_hash_add - add a NAPI to global hashtable
+ *	@napi: napi context
+ *
+ * generate a new napi_id and store a @napi under it in napi_hash
+ */
+extern void napi_hash_add(struct napi_struct *napi);
+
+/**
+ *	napi_hash_del - remove a NAPI from global table
+ *	@napi: napi context
+ *
+ * Warning: caller must observe rcu grace period
+ * before freeing memory containing @napi
+ */
+extern void napi_hash_del(struct napi_struct *napi);
+
 /**
  *	napi_disable - prevent NAPI from scheduling
  *	@n: napi context
@@ -699,6 +729,27 @@ struct netdev_fcoe_hbainfo {
 };
 #endif
 
+/* Commands of ndo_xdp, see IFLA_XDP */
+enum xdp_netdev_command {
+	/* Install or replace the receive program, NULL removes it.  On
+	 * success the driver owns the reference of the new program and
+	 * releases the old one with sk_unattached_filter_destroy().
+	 */
+	XDP_SETUP_PROG,
+	/* Report whether a program is installed. */
+	XDP_QUERY_PROG,
+};
+
+struct netdev_xdp {
+	enum xdp_netdev_command command;
+	union {
+		/* XDP_SETUP_PROG */
+		struct sk_filter *prog;
+		/* XDP_QUERY_PROG */
+		bool prog_attached;
+	};
+};
+
 /*
  * This structure defines the management hooks for network devices.
  * The following hooks can be defined; unless noted otherwise, they are
@@ -793,6 +844,12 @@ struct netdev_fcoe_hbainfo {
  *
  * void (*ndo_poll_controller)(struct net_device *dev);
  *
+ * int (*ndo_busy_poll)(struct napi_struct *dev);
+ *	Called from the socket layer to poll a NAPI context for new
+ *	packets without waiting for its interrupt. Returns the number of
+ *	packets received, LL_FLUSH_BUSY if the context is owned by NAPI,
+ *	or LL_FLUSH_FAILED if the device is going down.
+ *
  *	SR-IOV management functions.
  * int (*ndo_set_vf_mac)(struct net_device *dev, int vf, u8* mac);
  * int (*ndo_set_vf_vlan)(struct net_device *dev, int vf, u16 vlan, u8 qos);
@@ -902,6 +959,11 @@ struct netdev_fcoe_hbainfo {
  *	that determine carrier state from physical hardware properties (eg
  *	network cables) or protocol-dependent mechanisms (eg
  *	USB_CDC_NOTIFY_NETWORK_CONNECTION) should NOT implement this function.
+ *
+ * int (*ndo_xdp)(struct net_device *dev, struct netdev_xdp *xdp);
+ *	Called under RTNL to install, remove or query a program that the
+ *	driver runs on received frames before building a socket buffer.
+ *	The program returns one of enum xdp_action.
  */
 struct net_device_ops {
 	int			(*ndo_init)(struct net_device *dev);
@@ -942,6 +1004,9 @@ struct net_device_ops {
 						     struct netpoll_info *info,
 						     gfp_t gfp);
 	void			(*ndo_netpoll_cleanup)(struct net_device *dev);
+#endif
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	int			(*ndo_busy_poll)(struct napi_struct *dev);
 #endif
 	int			(*ndo_set_vf_mac)(struct net_device *dev,
 						  int queue, u8 *mac);
@@ -1025,6 +1090,8 @@ struct net_device_ops {
 						      struct nlmsghdr *nlh);
 	int			(*ndo_change_carrier)(struct net_device *dev,
 						      bool new_carrier);
+	int			(*ndo_xdp)(struct net_device *dev,
+					   struct netdev_xdp *xdp);
 };
 
 /*
@@ -1517,13 +1584,16 @@ struct napi_gro_cb {
 	u16	count;
 
 	/* This is non-zero if the packet may be of the same flow. */
-	u8	same_flow;
+	u8	same_flow:1;
 
 	/* Free the skb? */
-	u8	free;
+	u8	free:2;
 #define NAPI_GRO_FREE		  1
 #define NAPI_GRO_FREE_STOLEN_HEAD 2
 
+	/* Set once a tunnel header was pulled, only one level is merged */
+	u8	encap_mark:1;
+
 	/* jiffies when first packet was created/queued */
 	unsigned long age;
 
@@ -1555,7 +1625,7 @@ struct offload_callbacks {
 	int			(*gso_send_check)(struct sk_buff *skb);
 	struct sk_buff		**(*gro_receive)(struct sk_buff **head,
 					       struct sk_buff *skb);
-	int			(*gro_complete)(struct sk_buff *skb);
+	int			(*gro_complete)(struct sk_buff *skb, int nhoff);
 };
 
 struct packet_offload {
@@ -1666,6 +1736,8 @@ extern void		__dev_remove_pack(struct packet_type *pt);
 extern void		dev_add_offload(struct packet_offload *po);
 extern void		dev_remove_offload(struct packet_offload *po);
 extern void		__dev_remove_offload(struct packet_offload *po);
+extern struct packet_offload *gro_find_receive_by_type(__be16 type);
+extern struct packet_offload *gro_find_complete_by_type(__be16 type);
 
 extern struct net_device	*dev_get_by_flags_rcu(struct net *net, unsigned short flags,
 						      unsigned short mask);
@@ -2236,6 +2308,10 @@ extern int		dev_set_mac_address(struct net_device *,
 					    struct sockaddr *);
 extern int		dev_change_carrier(struct net_device *,
 					   bool new_carrier);
+extern struct sk_buff	*validate_xmit_skb(struct sk_buff *skb,
+					   struct net_device *dev);
+extern struct sk_buff	*validate_xmit_skb_list(struct sk_buff *skb,
+						struct net_device *dev);
 extern int		dev_hard_start_xmit(struct sk_buff *skb,
 					    struct net_device *dev,
 					    struct netdev_queue *txq);
@@ -2765,6 +2841,7 @@ static inline bool net_gso_ok(netdev_features_t features, int gso_type)
 	BUILD_BUG_ON(SKB_GSO_TCP_ECN != (NETIF_F_TSO_ECN >> NETIF_F_GSO_SHIFT));
 	BUILD_BUG_ON(SKB_GSO_TCPV6   != (NETIF_F_TSO6 >> NETIF_F_GSO_SHIFT));
 	BUILD_BUG_ON(SKB_GSO_FCOE    != (NETIF_F_FSO >> NETIF_F_GSO_SHIFT));
+	BUILD_BUG_ON(SKB_GSO_UDP_L4  != (NETIF_F_GSO_UDP_L4 >> NETIF_F_GSO_SHIFT));
 
 	return (features & feature) == feature;
 }
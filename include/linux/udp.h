@@ -63,7 +63,8 @@ struct udp_sock {
 #define UDPLITE_SEND_CC  0x2  		/* set via udplite setsockopt         */
 #define UDPLITE_RECV_CC  0x4		/* set via udplite setsocktopt        */
 	__u8		 pcflag;        /* marks socket as UDP-Lite if > 0    */
-	__u8		 unused[3];
+	__u8		 gro_enabled;	/* Can accept GRO packets */
+	__u16		 gso_size;	/* Segment size of UDP_SEGMENT sends */
 	/*
 	 * For encapsulation sockets.
 	 */
@@ -84,4 +85,7 @@ static inline struct udp_sock *udp_sk(const struct sock *sk)
 
 #define IS_UDPLITE(__sk) (udp_sk(__sk)->pcflag)
 
+/* Most datagrams one UDP_SEGMENT send may be split into */
+#define UDP_MAX_SEGMENTS	(1 << 6UL)
+
 #endif	/* _LINUX_UDP_H */
@@ -69,6 +69,10 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		THP_SPLIT,
 		THP_ZERO_PAGE_ALLOC,
 		THP_ZERO_PAGE_ALLOC_FAILED,
+#endif
+#ifdef CONFIG_FORK_SHARE_PTE
+		PGTABLE_SHARED,
+		PGTABLE_COPIED,
 #endif
 		NR_VM_EVENT_ITEMS
 };
@@ -6,10 +6,13 @@
 #include <linux/mutex.h>
 #include <net/sock.h>
 
+struct scm_fp_list;
+
 extern void unix_inflight(struct file *fp);
 extern void unix_notinflight(struct file *fp);
 extern void unix_gc(void);
-extern void wait_for_unix_gc(void);
+extern void wait_for_unix_gc(struct scm_fp_list *fpl);
+extern void unix_gc_exit(void);
 extern struct sock *unix_get_socket(struct file *filp);
 extern struct sock *unix_peer_get(struct sock *);
 
@@ -17,7 +20,7 @@ extern struct sock *unix_peer_get(struct sock *);
 #define UNIX_HASH_BITS	8
 
 extern unsigned int unix_tot_inflight;
-extern spinlock_t unix_table_lock;
+extern spinlock_t unix_table_locks[2 * UNIX_HASH_SIZE];
 extern struct hlist_head unix_socket_table[2 * UNIX_HASH_SIZE];
 
 struct unix_address {
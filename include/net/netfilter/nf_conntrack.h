@@ -77,6 +77,7 @@ struct nf_conn {
 	struct nf_conntrack ct_general;
 
 	spinlock_t lock;
+	u16 cpu;	/* owner of the unconfirmed/dying/template list */
 
 	/* XXX should I move this to the tail ? - Y.K */
 	/* These are my tuples; original and reply */
@@ -251,6 +252,7 @@ extern void nf_ct_untracked_status_or(unsigned long bits);
 extern void
 nf_ct_iterate_cleanup(struct net *net, int (*iter)(struct nf_conn *i, void *data), void *data);
 extern void nf_conntrack_free(struct nf_conn *ct);
+extern void nf_conntrack_tmpl_insert(struct net *net, struct nf_conn *tmpl);
 extern struct nf_conn *
 nf_conntrack_alloc(struct net *net, u16 zone,
 		   const struct nf_conntrack_tuple *orig,
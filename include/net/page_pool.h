@@ -0,0 +1,53 @@
+#ifndef _NET_PAGE_POOL_H
+#define _NET_PAGE_POOL_H
+
+#include <linux/types.h>
+#include <linux/mm_types.h>
+#include <linux/dma-direction.h>
+
+struct device;
+
+/*
+ * A per RX queue cache of pages, kept DMA mapped across uses.
+ *
+ * Drivers hand each page they pass up the stack to the pool, which keeps
+ * an extra reference to it.  Once the stack has freed the skb the pool is
+ * the only owner left and the page can go back on the ring without
+ * another trip through the page allocator or the IOMMU.  The pool is not
+ * locked: all calls are serialized by the owner, usually from its NAPI
+ * poll and from refill paths that run with NAPI disabled.
+ */
+struct page_pool_params {
+	unsigned int		order;
+	unsigned int		size;	/* number of pages kept, rounded up */
+	struct device		*dev;	/* NULL if pages are not DMA mapped */
+	enum dma_data_direction	dma_dir;
+};
+
+struct page_pool_entry {
+	struct page		*page;
+	dma_addr_t		dma;
+};
+
+struct page_pool {
+	struct page_pool_params	p;
+	unsigned int		mask;
+	unsigned int		add;	/* next slot to store a page in */
+	unsigned int		remove;	/* oldest page stored */
+
+	/* statistics, owner context only */
+	u64			recycled;	/* allocations served by the ring */
+	u64			busy;		/* ring pages still held by the stack */
+	u64			full;		/* pages not kept, ring was full */
+
+	struct page_pool_entry	ring[0];
+};
+
+extern struct page_pool *page_pool_create(const struct page_pool_params *params);
+extern void page_pool_destroy(struct page_pool *pool);
+extern struct page *page_pool_alloc_pages(struct page_pool *pool, gfp_t gfp,
+					  dma_addr_t *dma);
+extern void page_pool_recycle(struct page_pool *pool, struct page *page,
+			      dma_addr_t dma);
+
+#endif /* _NET_PAGE_POOL_H */
@@ -95,7 +95,7 @@ extern void qdisc_put_stab(struct qdisc_size_table *tab);
 extern void qdisc_warn_nonwc(char *txt, struct Qdisc *qdisc);
 extern int sch_direct_xmit(struct sk_buff *skb, struct Qdisc *q,
 			   struct net_device *dev, struct netdev_queue *txq,
-			   spinlock_t *root_lock);
+			   spinlock_t *root_lock, bool validate);
 
 extern void __qdisc_run(struct Qdisc *q);
 
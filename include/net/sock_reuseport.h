@@ -0,0 +1,53 @@
+#ifndef _SOCK_REUSEPORT_H
+#define _SOCK_REUSEPORT_H
+
+#include <linux/types.h>
+#include <linux/rcupdate.h>
+#include <net/sock.h>
+
+/*
+ * A SO_REUSEPORT group: all sockets bound to the same local address and
+ * port by the same user.  Lookups pick a member from socks[] with the
+ * flow hash instead of scoring every socket of the hash chain.
+ */
+struct sock_reuseport {
+	struct rcu_head		rcu;
+
+	u16			max_socks;	/* length of socks */
+	u16			num_socks;	/* elements in socks */
+	unsigned int		has_conns:1;	/* a member called connect() */
+	struct sock		*socks[0];	/* array of sock pointers */
+};
+
+extern int reuseport_alloc(struct sock *sk);
+extern int reuseport_add_sock(struct sock *sk, struct sock *sk2);
+extern void reuseport_detach_sock(struct sock *sk);
+extern struct sock *reuseport_select_sock(struct sock *sk, u32 hash);
+extern bool reuseport_saddr_equal(const struct sock *sk,
+				  const struct sock *sk2);
+extern int reuseport_sock_rank(const struct sock *sk);
+extern void reuseport_add_node_rcu(struct sock *sk,
+				   struct hlist_nulls_head *list);
+
+/*
+ * A connected member scores above its group for its own flow, so the
+ * lookups must keep scoring the chain once any member is connected.
+ */
+static inline bool reuseport_has_conns(struct sock *sk, bool set)
+{
+	struct sock_reuseport *reuse;
+	bool ret = false;
+
+	rcu_read_lock();
+	reuse = rcu_dereference(sk->sk_reuseport_cb);
+	if (reuse) {
+		if (set)
+			reuse->has_conns = 1;
+		ret = reuse->has_conns;
+	}
+	rcu_read_unlock();
+
+	return ret;
+}
+
+#endif  /* _SOCK_REUSEPORT_H */
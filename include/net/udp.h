@@ -156,6 +156,17 @@ static inline __wsum udp_csum(struct sk_buff *skb)
 	return csum;
 }
 
+/* Tell a UDP_GRO socket the size of the datagrams a GRO skb was made of */
+static inline void udp_cmsg_recv(struct msghdr *msg, struct sk_buff *skb)
+{
+	int gso_size;
+
+	if (skb_shinfo(skb)->gso_type & SKB_GSO_UDP_L4) {
+		gso_size = skb_shinfo(skb)->gso_size;
+		put_cmsg(msg, SOL_UDP, UDP_GRO, sizeof(gso_size), &gso_size);
+	}
+}
+
 /* hash routines shared between UDPv4/6 and UDP-Litev4/6 */
 static inline void udp_lib_hash(struct sock *sk)
 {
@@ -268,6 +279,19 @@ extern void udp_init(void);
 extern int udp4_ufo_send_check(struct sk_buff *skb);
 extern struct sk_buff *udp4_ufo_fragment(struct sk_buff *skb,
 	netdev_features_t features);
+extern struct sk_buff **udp4_gro_receive(struct sk_buff **head,
+					 struct sk_buff *skb);
+extern int udp4_gro_complete(struct sk_buff *skb, int nhoff);
+
+/* GRO handlers of a UDP encapsulation, keyed by destination port */
+struct udp_offload {
+	__be16			 port;
+	struct offload_callbacks callbacks;
+	struct list_head	 list;
+};
+
+extern void udp_add_offload(struct udp_offload *uo);
+extern void udp_del_offload(struct udp_offload *uo);
 extern void udp_encap_enable(void);
 #if IS_ENABLED(CONFIG_IPV6)
 extern void udpv6_encap_enable(void);
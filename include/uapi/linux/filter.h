@@ -134,5 +134,15 @@ struct sock_fprog {	/* Required for SO_ATTACH_FILTER. */
 #define SKF_NET_OFF   (-0x100000)
 #define SKF_LL_OFF    (-0x200000)
 
+/*
+ * Return values of a program attached to the receive path of a device
+ * with IFLA_XDP, it runs on the frame before any socket buffer exists.
+ */
+enum xdp_action {
+	XDP_ABORTED = 0,	/* program error, the frame is dropped */
+	XDP_DROP,		/* drop the frame */
+	XDP_PASS,		/* let the frame go up the stack */
+	XDP_TX,			/* send the frame back out the same port */
+};
 
 #endif /* _UAPI__LINUX_FILTER_H__ */
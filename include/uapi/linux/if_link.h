@@ -143,6 +143,7 @@ enum {
 	IFLA_NUM_TX_QUEUES,
 	IFLA_NUM_RX_QUEUES,
 	IFLA_CARRIER,
+	IFLA_XDP,
 	__IFLA_MAX
 };
 
@@ -452,4 +453,21 @@ enum {
 
 #define IFLA_IPOIB_MAX (__IFLA_IPOIB_MAX - 1)
 
+
+/* XDP section
+ *
+ * Nested attributes of IFLA_XDP.  IFLA_XDP_PROG carries an array of
+ * struct sock_filter whose return value is one of enum xdp_action, an
+ * empty array detaches the program.  IFLA_XDP_ATTACHED is only reported.
+ */
+
+enum {
+	IFLA_XDP_UNSPEC,
+	IFLA_XDP_PROG,
+	IFLA_XDP_ATTACHED,
+	__IFLA_XDP_MAX,
+};
+
+#define IFLA_XDP_MAX (__IFLA_XDP_MAX - 1)
+
 #endif /* _UAPI_LINUX_IF_LINK_H */
@@ -51,11 +51,17 @@ struct sockaddr_ll {
 #define PACKET_TIMESTAMP		17
 #define PACKET_FANOUT			18
 #define PACKET_TX_HAS_OFF		19
+#define PACKET_QDISC_BYPASS		20
+#define PACKET_FANOUT_STATS		21
+#define PACKET_FANOUT_DATA		22
 
 #define PACKET_FANOUT_HASH		0
 #define PACKET_FANOUT_LB		1
 #define PACKET_FANOUT_CPU		2
 #define PACKET_FANOUT_ROLLOVER		3
+#define PACKET_FANOUT_RND		4
+#define PACKET_FANOUT_QM		5
+#define PACKET_FANOUT_CBPF		6
 #define PACKET_FANOUT_FLAG_ROLLOVER	0x1000
 #define PACKET_FANOUT_FLAG_DEFRAG	0x8000
 
@@ -75,6 +81,13 @@ union tpacket_stats_u {
 	struct tpacket_stats_v3 stats3;
 };
 
+/* Totals since the socket was created, not cleared on read */
+struct tpacket_fanout_stats {
+	__aligned_u64	tp_packets;
+	__aligned_u64	tp_drops;
+	__aligned_u64	tp_rollover;	/* handed to another group member */
+};
+
 struct tpacket_auxdata {
 	__u32		tp_status;
 	__u32		tp_len;
@@ -36,6 +36,7 @@
 #define TUN_PERSIST 	0x0100	
 #define TUN_VNET_HDR 	0x0200
 #define TUN_TAP_MQ      0x0400
+#define TUN_NAPI	0x0800
 
 /* Ioctl defines */
 #define TUNSETNOCSUM  _IOW('T', 200, int) 
@@ -56,6 +57,8 @@
 #define TUNGETVNETHDRSZ _IOR('T', 215, int)
 #define TUNSETVNETHDRSZ _IOW('T', 216, int)
 #define TUNSETQUEUE  _IOW('T', 217, int)
+#define TUNSENDPKTS  _IOW('T', 218, struct tun_pkts)
+#define TUNRECVPKTS  _IOW('T', 219, struct tun_pkts)
 
 /* TUNSETIFF ifr flags */
 #define IFF_TUN		0x0001
@@ -68,6 +71,7 @@
 #define IFF_MULTI_QUEUE 0x0100
 #define IFF_ATTACH_QUEUE 0x0200
 #define IFF_DETACH_QUEUE 0x0400
+#define IFF_NAPI	0x0010
 
 /* Features for GSO (TUNSETOFFLOAD). */
 #define TUN_F_CSUM	0x01	/* You can hand me unchecksummed packets. */
@@ -83,6 +87,26 @@ struct tun_pi {
 	__be16 proto;
 };
 
+/*
+ * Batched packet I/O (TUNSENDPKTS/TUNRECVPKTS).
+ * Each tun_pkt describes one packet, laid out exactly as it would be for
+ * a single read() or write() on the device. On return len holds the
+ * number of bytes transferred, and TUN_PKT_STRIP is set in flags if a
+ * received packet did not fit in its buffer. The ioctls return the number
+ * of packets transferred; only the first packet may block.
+ */
+struct tun_pkt {
+	__u64	buf;	/* Userspace address of the packet buffer */
+	__u32	len;	/* Size of the buffer */
+	__u32	flags;
+};
+
+struct tun_pkts {
+	__u64	pkts;	/* Userspace address of a tun_pkt array */
+	__u32	count;	/* Number of entries, at most UIO_MAXIOV */
+	__u32	flags;	/* Must be zero */
+};
+
 /*
  * Filter spec (used for SETXXFILTER ioctls)
  * This stuff is applicable only to the TAP (Ethernet) devices.
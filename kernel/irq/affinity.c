@@ -0,0 +1,130 @@
+/*
+ * linux/kernel/irq/affinity.c
+ *
+ * Default placement of the vectors of multi-queue devices.
+ *
+ * Without a userspace balancer every vector of a device ends up with
+ * the default affinity, which most interrupt controllers resolve to the
+ * first online cpu. Drivers can instead ask for vector N of M to be
+ * given its own share of the online cpus, walking the device's home
+ * node first and then the remaining nodes.
+ */
+
+#include <linux/irq.h>
+#include <linux/interrupt.h>
+#include <linux/cpu.h>
+#include <linux/slab.h>
+
+#include "internals.h"
+
+/*
+ * Return the cpu that is @idx'th in spreading order: the online cpus of
+ * @node first, followed by those of the other online nodes in turn.
+ */
+static int irq_spread_nth_cpu(unsigned int idx, int node)
+{
+	int n, first, cpu;
+
+	if (node == NUMA_NO_NODE || !node_online(node))
+		node = first_online_node;
+
+	first = node;
+	n = node;
+	do {
+		for_each_cpu_and(cpu, cpumask_of_node(n), cpu_online_mask) {
+			if (!idx--)
+				return cpu;
+		}
+		n = next_online_node(n);
+		if (n == MAX_NUMNODES)
+			n = first_online_node;
+	} while (n != first);
+
+	return cpumask_first(cpu_online_mask);
+}
+
+/**
+ *	irq_spread_affinity_mask - compute the cpus for one vector of a device
+ *	@vec:		index of the vector, 0 <= @vec < @nvec
+ *	@nvec:		number of vectors of the device being spread
+ *	@node:		home node of the device, or NUMA_NO_NODE
+ *	@mask:		result
+ *
+ *	With fewer vectors than online cpus each vector gets a contiguous
+ *	range of cpus in spreading order, so that vectors land on the
+ *	device's node first and nodes receive vectors in proportion to
+ *	their cpu count. With more vectors than cpus they wrap around.
+ *
+ *	Must be called in process context.
+ */
+void irq_spread_affinity_mask(unsigned int vec, unsigned int nvec, int node,
+			      struct cpumask *mask)
+{
+	unsigned int ncpus, first, last, i;
+
+	cpumask_clear(mask);
+
+	get_online_cpus();
+	ncpus = num_online_cpus();
+	if (!nvec || nvec >= ncpus) {
+		first = vec % ncpus;
+		last = first + 1;
+	} else {
+		first = vec * ncpus / nvec;
+		last = (vec + 1) * ncpus / nvec;
+	}
+
+	for (i = first; i < last; i++)
+		cpumask_set_cpu(irq_spread_nth_cpu(i, node), mask);
+	put_online_cpus();
+}
+EXPORT_SYMBOL_GPL(irq_spread_affinity_mask);
+
+/**
+ *	irq_spread_affinity - place one vector of a multi-queue device
+ *	@irq:		Interrupt to place
+ *	@vec:		index of the vector, 0 <= @vec < @nvec
+ *	@nvec:		number of vectors of the device being spread
+ *	@node:		home node of the device, or NUMA_NO_NODE
+ *
+ *	Intended to be called for each vector once the device has allocated
+ *	them. The affinity is recorded as if set by the user, so it is kept
+ *	when the interrupt is requested and can still be overridden via
+ *	/proc/irq/N/smp_affinity. If the interrupt is already active the
+ *	new affinity takes effect immediately. An affinity that was already
+ *	set, by the user or an earlier call, is left alone so that drivers
+ *	may call this each time they request their interrupts.
+ */
+int irq_spread_affinity(unsigned int irq, unsigned int vec, unsigned int nvec,
+			int node)
+{
+	struct irq_desc *desc = irq_to_desc(irq);
+	cpumask_var_t mask;
+	unsigned long flags;
+	int ret = 0;
+
+	if (!desc || !irq_can_set_affinity(irq))
+		return -EINVAL;
+
+	if (!alloc_cpumask_var(&mask, GFP_KERNEL))
+		return -ENOMEM;
+
+	irq_spread_affinity_mask(vec, nvec, node, mask);
+
+	raw_spin_lock_irqsave(&desc->lock, flags);
+	if (irqd_has_set(&desc->irq_data, IRQD_AFFINITY_SET))
+		goto out_unlock;
+
+	if (desc->action) {
+		ret = __irq_set_affinity_locked(&desc->irq_data, mask);
+	} else {
+		cpumask_copy(desc->irq_data.affinity, mask);
+		irqd_set(&desc->irq_data, IRQD_AFFINITY_SET);
+	}
+out_unlock:
+	raw_spin_unlock_irqrestore(&desc->lock, flags);
+
+	free_cpumask_var(mask);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(irq_spread_affinity);
@@ -12,6 +12,8 @@
 #include <linux/gfp.h>
 #include <linux/smp.h>
 #include <linux/cpu.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 
 #include "smpboot.h"
 
@@ -28,12 +30,19 @@ struct call_function_data {
 
 static DEFINE_PER_CPU_SHARED_ALIGNED(struct call_function_data, cfd_data);
 
-struct call_single_queue {
-	struct list_head	list;
-	raw_spinlock_t		lock;
+static DEFINE_PER_CPU_SHARED_ALIGNED(struct llist_head, call_single_queue);
+
+/*
+ * Per-cpu accounting of cross-cpu calls queued by this cpu: how many
+ * needed an IPI and how many piggy-backed on one already in flight
+ * because the target queue was not empty.
+ */
+struct call_function_stat {
+	unsigned long		ipi_sent;
+	unsigned long		ipi_saved;
 };
 
-static DEFINE_PER_CPU_SHARED_ALIGNED(struct call_single_queue, call_single_queue);
+static DEFINE_PER_CPU(struct call_function_stat, call_function_stat);
 
 static int
 hotplug_cfd(struct notifier_block *nfb, unsigned long action, void *hcpu)
@@ -82,12 +91,8 @@ void __init call_function_init(void)
 	void *cpu = (void *)(long)smp_processor_id();
 	int i;
 
-	for_each_possible_cpu(i) {
-		struct call_single_queue *q = &per_cpu(call_single_queue, i);
-
-		raw_spin_lock_init(&q->lock);
-		INIT_LIST_HEAD(&q->list);
-	}
+	for_each_possible_cpu(i)
+		init_llist_head(&per_cpu(call_single_queue, i));
 
 	hotplug_cfd(&hotplug_cfd_notifier, CPU_UP_PREPARE, cpu);
 	register_cpu_notifier(&hotplug_cfd_notifier);
@@ -139,15 +144,6 @@ static void csd_unlock(struct call_single_data *csd)
 static
 void generic_exec_single(int cpu, struct call_single_data *csd, int wait)
 {
-	struct call_single_queue *dst = &per_cpu(call_single_queue, cpu);
-	unsigned long flags;
-	int ipi;
-
-	raw_spin_lock_irqsave(&dst->lock, flags);
-	ipi = list_empty(&dst->list);
-	list_add_tail(&csd->list, &dst->list);
-	raw_spin_unlock_irqrestore(&dst->lock, flags);
-
 	/*
 	 * The list addition should be visible before sending the IPI
 	 * handler locks the list to pull the entry off it because of
@@ -158,9 +154,16 @@ void generic_exec_single(int cpu, struct call_single_data *csd, int wait)
 	 * to arch code to make it appear to obey cache coherency WRT
 	 * locking and barrier primitives. Generic code isn't really
 	 * equipped to do the right thing...
+	 *
+	 * Only the first entry on an empty queue needs an IPI: any later
+	 * entry is picked up by the handler run for the one already sent.
 	 */
-	if (ipi)
+	if (llist_add(&csd->llist, &per_cpu(call_single_queue, cpu))) {
+		this_cpu_inc(call_function_stat.ipi_sent);
 		arch_send_call_function_single_ipi(cpu);
+	} else {
+		this_cpu_inc(call_function_stat.ipi_saved);
+	}
 
 	if (wait)
 		csd_lock_wait(csd);
@@ -172,25 +175,20 @@ void generic_exec_single(int cpu, struct call_single_data *csd, int wait)
  */
 void generic_smp_call_function_single_interrupt(void)
 {
-	struct call_single_queue *q = &__get_cpu_var(call_single_queue);
-	LIST_HEAD(list);
+	struct llist_node *entry;
+	struct call_single_data *csd, *csd_next;
 
 	/*
 	 * Shouldn't receive this interrupt on a cpu that is not yet online.
 	 */
 	WARN_ON_ONCE(!cpu_online(smp_processor_id()));
 
-	raw_spin_lock(&q->lock);
-	list_replace_init(&q->list, &list);
-	raw_spin_unlock(&q->lock);
+	entry = llist_del_all(&__get_cpu_var(call_single_queue));
+	entry = llist_reverse_order(entry);
 
-	while (!list_empty(&list)) {
-		struct call_single_data *csd;
+	llist_for_each_entry_safe(csd, csd_next, entry, llist) {
 		unsigned int csd_flags;
 
-		csd = list_entry(list.next, struct call_single_data, list);
-		list_del(&csd->list);
-
 		/*
 		 * 'csd' can be invalid after this call if flags == 0
 		 * (when called through generic_exec_single()),
@@ -371,6 +369,7 @@ void smp_call_function_many(const struct cpumask *mask,
 {
 	struct call_function_data *cfd;
 	int cpu, next_cpu, this_cpu = smp_processor_id();
+	unsigned int ipis;
 
 	/*
 	 * Can deadlock when called with interrupts disabled.
@@ -410,30 +409,26 @@ void smp_call_function_many(const struct cpumask *mask,
 	if (unlikely(!cpumask_weight(cfd->cpumask)))
 		return;
 
-	/*
-	 * After we put an entry into the list, cfd->cpumask may be cleared
-	 * again when another CPU sends another IPI for a SMP function call, so
-	 * cfd->cpumask will be zero.
-	 */
-	cpumask_copy(cfd->cpumask_ipi, cfd->cpumask);
-
+	cpumask_clear(cfd->cpumask_ipi);
 	for_each_cpu(cpu, cfd->cpumask) {
 		struct call_single_data *csd = per_cpu_ptr(cfd->csd, cpu);
-		struct call_single_queue *dst =
-					&per_cpu(call_single_queue, cpu);
-		unsigned long flags;
 
 		csd_lock(csd);
 		csd->func = func;
 		csd->info = info;
 
-		raw_spin_lock_irqsave(&dst->lock, flags);
-		list_add_tail(&csd->list, &dst->list);
-		raw_spin_unlock_irqrestore(&dst->lock, flags);
+		/* A non-empty queue already has an IPI on its way */
+		if (llist_add(&csd->llist, &per_cpu(call_single_queue, cpu)))
+			cpumask_set_cpu(cpu, cfd->cpumask_ipi);
 	}
 
-	/* Send a message to all CPUs in the map */
-	arch_send_call_function_ipi_mask(cfd->cpumask_ipi);
+	/* Send a message to the CPUs whose queue was empty */
+	ipis = cpumask_weight(cfd->cpumask_ipi);
+	this_cpu_add(call_function_stat.ipi_sent, ipis);
+	this_cpu_add(call_function_stat.ipi_saved,
+		     cpumask_weight(cfd->cpumask) - ipis);
+	if (ipis)
+		arch_send_call_function_ipi_mask(cfd->cpumask_ipi);
 
 	if (wait) {
 		for_each_cpu(cpu, cfd->cpumask) {
@@ -470,6 +465,58 @@ int smp_call_function(smp_call_func_t func, void *info, int wait)
 	return 0;
 }
 EXPORT_SYMBOL(smp_call_function);
+
+#ifdef CONFIG_PROC_FS
+/*
+ * /proc/smp_calls: per-cpu count of call-function IPIs sent, and of
+ * calls that were queued behind an IPI already pending on the target.
+ */
+static int show_smp_calls(struct seq_file *p, void *v)
+{
+	char name[16];
+	int i;
+
+	/* one column per online CPU, as in /proc/interrupts */
+	seq_printf(p, "%9s", "");
+	for_each_online_cpu(i) {
+		snprintf(name, sizeof(name), "CPU%d", i);
+		seq_printf(p, " %10s", name);
+	}
+	seq_putc(p, '\n');
+
+	seq_printf(p, "%8s:", "SENT");
+	for_each_online_cpu(i)
+		seq_printf(p, " %10lu",
+			   per_cpu(call_function_stat, i).ipi_sent);
+	seq_putc(p, '\n');
+
+	seq_printf(p, "%8s:", "SAVED");
+	for_each_online_cpu(i)
+		seq_printf(p, " %10lu",
+			   per_cpu(call_function_stat, i).ipi_saved);
+	seq_putc(p, '\n');
+	return 0;
+}
+
+static int smp_calls_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, show_smp_calls, NULL);
+}
+
+static const struct file_operations proc_smp_calls_operations = {
+	.open		= smp_calls_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init proc_smp_calls_init(void)
+{
+	proc_create("smp_calls", 0, NULL, &proc_smp_calls_operations);
+	return 0;
+}
+module_init(proc_smp_calls_init);
+#endif /* CONFIG_PROC_FS */
 #endif /* USE_GENERIC_SMP_HELPERS */
 
 /* Setup configured maximum number of CPUs to activate */
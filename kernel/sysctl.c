@@ -1445,6 +1445,17 @@ static struct ctl_table vm_table[] = {
 		.extra1		= &zero,
 		.extra2		= &one,
 	},
+#endif
+#ifdef CONFIG_FORK_SHARE_PTE
+	{
+		.procname	= "fork_share_pte",
+		.data		= &sysctl_fork_share_pte,
+		.maxlen		= sizeof(sysctl_fork_share_pte),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &one,
+	},
 #endif
 	{
 		.procname	= "user_reserve_kbytes",
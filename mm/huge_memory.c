@@ -2323,7 +2323,7 @@ static void collapse_huge_page(struct mm_struct *mm,
 	pmd = mm_find_pmd(mm, address);
 	if (!pmd)
 		goto out;
-	if (pmd_trans_huge(*pmd))
+	if (pmd_trans_huge(*pmd) || pte_table_shared(pmd))
 		goto out;
 
 	anon_vma_lock_write(vma->anon_vma);
@@ -1757,6 +1757,11 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 			return 0;
 #endif
 
+		/* ksmd must not merge pages behind a forked mm's back */
+		err = unshare_pte_tables(vma, start, end);
+		if (err)
+			return err;
+
 		if (!test_bit(MMF_VM_MERGEABLE, &mm->flags)) {
 			err = __ksm_enter(mm);
 			if (err)
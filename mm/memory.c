@@ -59,6 +59,7 @@
 #include <linux/gfp.h>
 #include <linux/migrate.h>
 #include <linux/string.h>
+#include <linux/debugfs.h>
 
 #include <asm/io.h>
 #include <asm/pgalloc.h>
@@ -965,6 +966,279 @@ again:
 	return 0;
 }
 
+#ifdef CONFIG_FORK_SHARE_PTE
+int sysctl_fork_share_pte __read_mostly;
+
+/*
+ * The pt_share_count of a pte page must change under a lock common to
+ * all the mms mapping it. That is the split pte lock of the table; the
+ * per-mm page_table_lock used without split pte locks is not, so one
+ * global lock stands in for it then.
+ */
+#if USE_SPLIT_PTLOCKS
+static inline spinlock_t *pte_share_lockptr(struct mm_struct *mm, pmd_t *pmd)
+{
+	return pte_lockptr(mm, pmd);
+}
+#else
+static DEFINE_SPINLOCK(pte_share_lock);
+
+static inline spinlock_t *pte_share_lockptr(struct mm_struct *mm, pmd_t *pmd)
+{
+	return &pte_share_lock;
+}
+#endif
+
+/*
+ * Only whole pte pages of private anonymous mappings are shared across
+ * fork. Such a table stands for a single mapping of each of its pages:
+ * fork takes no page references or mapcounts for it, so nothing may
+ * modify its entries before the mm doing so has unshared it. Faults,
+ * mprotect, mremap and partial unmaps therefore unshare first, while
+ * reclaim and migration leave such pages alone.
+ */
+static inline bool can_share_pte_table(struct vm_area_struct *vma,
+				       pmd_t *src_pmd, unsigned long addr,
+				       unsigned long end)
+{
+	if (!sysctl_fork_share_pte)
+		return false;
+	if ((addr & ~PMD_MASK) || end - addr != PMD_SIZE)
+		return false;
+	if (vma->vm_file || !vma->anon_vma)
+		return false;
+	if (vma->vm_flags & (VM_SHARED | VM_LOCKED | VM_MERGEABLE))
+		return false;
+	return !pmd_numa(*src_pmd);
+}
+
+/*
+ * Make dst_mm map the pte page of src_pmd instead of a copy of it. All
+ * entries are write protected, so the first write in either mm faults
+ * and unshares the table. Tables holding swap or migration entries are
+ * left to copy_pte_range(), which returns -EAGAIN here.
+ */
+static int share_pte_table(struct mm_struct *dst_mm, struct mm_struct *src_mm,
+			   pmd_t *dst_pmd, pmd_t *src_pmd,
+			   struct vm_area_struct *vma, unsigned long addr)
+{
+	unsigned long end = addr + PMD_SIZE;
+	pgtable_t table = pmd_pgtable(*src_pmd);
+	pte_t *src_pte, *orig_src_pte;
+	spinlock_t *src_ptl, *share_ptl;
+	int rss[NR_MM_COUNTERS];
+	int ret = 0;
+
+	init_rss_vec(rss);
+	src_pte = pte_offset_map_lock(src_mm, src_pmd, addr, &src_ptl);
+	orig_src_pte = src_pte;
+	arch_enter_lazy_mmu_mode();
+	do {
+		pte_t pte = *src_pte;
+
+		if (pte_none(pte))
+			continue;
+		if (!pte_present(pte)) {
+			ret = -EAGAIN;
+			break;
+		}
+		if (pte_write(pte))
+			ptep_set_wrprotect(src_mm, addr, src_pte);
+		if (vm_normal_page(vma, addr, pte))
+			rss[MM_ANONPAGES]++;
+	} while (src_pte++, addr += PAGE_SIZE, addr != end);
+	arch_leave_lazy_mmu_mode();
+	if (!ret) {
+		share_ptl = pte_share_lockptr(src_mm, src_pmd);
+		if (share_ptl != src_ptl)
+			spin_lock(share_ptl);
+		table->pt_share_count++;
+		if (share_ptl != src_ptl)
+			spin_unlock(share_ptl);
+	}
+	pte_unmap_unlock(orig_src_pte, src_ptl);
+	if (ret)
+		return ret;
+
+	spin_lock(&dst_mm->page_table_lock);
+	dst_mm->nr_ptes++;
+	pmd_populate(dst_mm, dst_pmd, table);
+	spin_unlock(&dst_mm->page_table_lock);
+	add_mm_rss_vec(dst_mm, rss);
+	count_vm_event(PGTABLE_SHARED);
+	return 0;
+}
+
+/*
+ * Give mm a private copy of the pte page shared through pmd, taking the
+ * page references and mapcounts that fork skipped. The last mm mapping
+ * a shared table just keeps it. The anon_vma lock keeps rmap walkers
+ * from looking at the pmd while it changes under them.
+ */
+int unshare_pte_table(struct mm_struct *mm, struct vm_area_struct *vma,
+		      pmd_t *pmd, unsigned long address)
+{
+	unsigned long start = address & PMD_MASK;
+	unsigned long addr = start;
+	pte_t *src_pte, *dst_pte, *orig_src_pte, *orig_dst_pte;
+	pgtable_t new, table;
+	spinlock_t *ptl;
+
+	VM_BUG_ON(!vma->anon_vma);
+	new = pte_alloc_one(mm, start);
+	if (!new)
+		return -ENOMEM;
+	smp_wmb(); /* See comment in __pte_alloc */
+
+	anon_vma_lock_write(vma->anon_vma);
+	spin_lock(&mm->page_table_lock);
+	if (!pte_table_shared(pmd))
+		goto out;
+	table = pmd_pgtable(*pmd);
+	ptl = pte_share_lockptr(mm, pmd);
+	spin_lock(ptl);
+	if (!table->pt_share_count)
+		goto out_unlock;
+
+	src_pte = pte_offset_map(pmd, start);
+	dst_pte = (pte_t *)kmap_atomic(new);
+	orig_src_pte = src_pte;
+	orig_dst_pte = dst_pte;
+	do {
+		pte_t pte = *src_pte;
+		struct page *page;
+
+		if (pte_none(pte))
+			continue;
+		page = vm_normal_page(vma, addr, pte);
+		if (page) {
+			get_page(page);
+			page_dup_rmap(page);
+		}
+		set_pte_at(mm, addr, dst_pte, pte);
+	} while (dst_pte++, src_pte++, addr += PAGE_SIZE, addr != start + PMD_SIZE);
+	pte_unmap(orig_dst_pte);
+	pte_unmap(orig_src_pte);
+
+	pmd_populate(mm, pmd, new);
+	/* No cpu may walk the old table on behalf of this mm any more */
+	flush_tlb_range(vma, start, start + PMD_SIZE);
+	table->pt_share_count--;
+	count_vm_event(PGTABLE_COPIED);
+	new = NULL;
+out_unlock:
+	spin_unlock(ptl);
+out:
+	spin_unlock(&mm->page_table_lock);
+	anon_vma_unlock_write(vma->anon_vma);
+	if (new)
+		pte_free(mm, new);
+	return 0;
+}
+
+int unshare_pte_tables(struct vm_area_struct *vma, unsigned long start,
+		       unsigned long end)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned long addr;
+	pmd_t *pmd;
+
+	for (addr = start & PMD_MASK; addr < end; addr += PMD_SIZE) {
+		pmd = mm_find_pmd(mm, addr);
+		if (pmd && pte_table_shared(pmd) &&
+		    unshare_pte_table(mm, vma, pmd, addr))
+			return -ENOMEM;
+	}
+	return 0;
+}
+
+/*
+ * Drop this mm's share of a pte page rather than zapping entries that
+ * other mms still map. A partially unmapped table is unshared and then
+ * zapped as usual. Returns true if the pmd is left empty.
+ */
+static bool zap_shared_pte_table(struct mmu_gather *tlb,
+				 struct vm_area_struct *vma, pmd_t *pmd,
+				 unsigned long addr, unsigned long end)
+{
+	struct mm_struct *mm = tlb->mm;
+	unsigned long start = addr & PMD_MASK;
+	int rss[NR_MM_COUNTERS];
+	pte_t *pte, *orig_pte;
+	pgtable_t table;
+	spinlock_t *ptl;
+	bool ret = true;
+
+	if (!tlb->fullmm && end - addr != PMD_SIZE) {
+		/*
+		 * Only an OOM victim fails to get a page table here; let it
+		 * lose the rest of the table rather than zap the entries
+		 * of the other sharers.
+		 */
+		if (!WARN_ON_ONCE(unshare_pte_table(mm, vma, pmd, addr)))
+			return pmd_none(*pmd);
+	}
+
+	init_rss_vec(rss);
+	anon_vma_lock_write(vma->anon_vma);
+	spin_lock(&mm->page_table_lock);
+	if (!pte_table_shared(pmd)) {
+		ret = pmd_none(*pmd);
+		goto out;
+	}
+	table = pmd_pgtable(*pmd);
+	ptl = pte_share_lockptr(mm, pmd);
+	spin_lock(ptl);
+	if (!table->pt_share_count) {
+		ret = false;
+		goto out_unlock;
+	}
+
+	pte = pte_offset_map(pmd, start);
+	orig_pte = pte;
+	addr = start;
+	do {
+		if (!pte_none(*pte) && vm_normal_page(vma, addr, *pte))
+			rss[MM_ANONPAGES]--;
+	} while (pte++, addr += PAGE_SIZE, addr != start + PMD_SIZE);
+	pte_unmap(orig_pte);
+
+	pmd_clear(pmd);
+	mm->nr_ptes--;
+	flush_tlb_range(vma, start, start + PMD_SIZE);
+	table->pt_share_count--;
+out_unlock:
+	spin_unlock(ptl);
+out:
+	spin_unlock(&mm->page_table_lock);
+	anon_vma_unlock_write(vma->anon_vma);
+	add_mm_rss_vec(mm, rss);
+	return ret;
+}
+#else
+static inline bool can_share_pte_table(struct vm_area_struct *vma,
+				       pmd_t *src_pmd, unsigned long addr,
+				       unsigned long end)
+{
+	return false;
+}
+
+static inline int share_pte_table(struct mm_struct *dst_mm,
+				  struct mm_struct *src_mm,
+				  pmd_t *dst_pmd, pmd_t *src_pmd,
+				  struct vm_area_struct *vma, unsigned long addr)
+{
+	return -EAGAIN;
+}
+
+static inline bool zap_shared_pte_table(struct mmu_gather *tlb,
+					struct vm_area_struct *vma, pmd_t *pmd,
+					unsigned long addr, unsigned long end)
+{
+	return false;
+}
+#endif /* CONFIG_FORK_SHARE_PTE */
+
 static inline int copy_pmd_range(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 		pud_t *dst_pud, pud_t *src_pud, struct vm_area_struct *vma,
 		unsigned long addr, unsigned long end)
@@ -991,6 +1265,10 @@ static inline int copy_pmd_range(struct mm_struct *dst_mm, struct mm_struct *src
 		}
 		if (pmd_none_or_clear_bad(src_pmd))
 			continue;
+		if (can_share_pte_table(vma, src_pmd, addr, next) &&
+		    !share_pte_table(dst_mm, src_mm, dst_pmd, src_pmd,
+				     vma, addr))
+			continue;
 		if (copy_pte_range(dst_mm, src_mm, dst_pmd, src_pmd,
 						vma, addr, next))
 			return -ENOMEM;
@@ -1262,6 +1540,9 @@ static inline unsigned long zap_pmd_range(struct mmu_gather *tlb,
 		 */
 		if (pmd_none_or_trans_huge_or_clear_bad(pmd))
 			goto next;
+		if (unlikely(pte_table_shared(pmd)) &&
+		    zap_shared_pte_table(tlb, vma, pmd, addr, next))
+			goto next;
 		next = zap_pte_range(tlb, vma, pmd, addr, next, details);
 next:
 		cond_resched();
@@ -3481,6 +3762,199 @@ uncharge_out:
 	return ret;
 }
 
+/*
+ * Map a page cache page read-only at address, for ->map_pages().
+ * The caller holds the pte lock and a reference on the page, which
+ * becomes the reference of the new mapping.
+ */
+void do_set_pte(struct vm_area_struct *vma, unsigned long address,
+		struct page *page, pte_t *pte)
+{
+	pte_t entry;
+
+	flush_icache_page(vma, page);
+	entry = mk_pte(page, vma->vm_page_prot);
+	inc_mm_counter_fast(vma->vm_mm, MM_FILEPAGES);
+	page_add_file_rmap(page);
+	set_pte_at(vma->vm_mm, address, pte, entry);
+
+	/* no need to invalidate: a not-present page won't be cached */
+	update_mmu_cache(vma, address, pte);
+}
+
+static unsigned long fault_around_bytes = 65536;
+
+/*
+ * Upper bound of what map_cached_pages() maps per call, so that exec of
+ * a large binary that only runs briefly doesn't pay for setting up and
+ * tearing down its whole text. 0 disables exec-time prefaulting.
+ */
+static unsigned long exec_prefault_bytes = 512 * 1024;
+
+/*
+ * Read faults on file mappings map up to fault_around_bytes worth of
+ * neighbouring pages that are already in the page cache, within the
+ * naturally aligned window around the fault and the same page table.
+ * fault_around_bytes is always a power of two; PAGE_SIZE disables it.
+ */
+static inline unsigned long fault_around_pages(void)
+{
+	return fault_around_bytes / PAGE_SIZE;
+}
+
+static inline unsigned long fault_around_mask(void)
+{
+	return ~(fault_around_bytes - 1) & PAGE_MASK;
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int fault_around_bytes_get(void *data, u64 *val)
+{
+	*val = fault_around_bytes;
+	return 0;
+}
+
+static int fault_around_bytes_set(void *data, u64 val)
+{
+	if (val / PAGE_SIZE > PTRS_PER_PTE)
+		return -EINVAL;
+	if (val > PAGE_SIZE)
+		fault_around_bytes = rounddown_pow_of_two(val);
+	else
+		fault_around_bytes = PAGE_SIZE; /* rounddown_pow_of_two(0) is undefined */
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(fault_around_bytes_fops,
+		fault_around_bytes_get, fault_around_bytes_set, "%llu\n");
+
+static int exec_prefault_bytes_get(void *data, u64 *val)
+{
+	*val = exec_prefault_bytes;
+	return 0;
+}
+
+static int exec_prefault_bytes_set(void *data, u64 val)
+{
+	if (val > TASK_SIZE)
+		return -EINVAL;
+	exec_prefault_bytes = val & PAGE_MASK;
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(exec_prefault_bytes_fops,
+		exec_prefault_bytes_get, exec_prefault_bytes_set, "%llu\n");
+
+static int __init fault_around_debugfs(void)
+{
+	void *ret;
+
+	ret = debugfs_create_file("fault_around_bytes", 0644, NULL, NULL,
+			&fault_around_bytes_fops);
+	if (!ret)
+		pr_warn("Failed to create fault_around_bytes in debugfs");
+
+	ret = debugfs_create_file("exec_prefault_bytes", 0644, NULL, NULL,
+			&exec_prefault_bytes_fops);
+	if (!ret)
+		pr_warn("Failed to create exec_prefault_bytes in debugfs");
+	return 0;
+}
+late_initcall(fault_around_debugfs);
+#endif
+
+static void do_fault_around(struct vm_area_struct *vma, unsigned long address,
+		pte_t *pte, pgoff_t pgoff, unsigned int flags)
+{
+	unsigned long start_addr;
+	pgoff_t max_pgoff;
+	struct vm_fault vmf;
+	int off;
+
+	start_addr = max(address & fault_around_mask(), vma->vm_start);
+	off = ((address - start_addr) >> PAGE_SHIFT) & (PTRS_PER_PTE - 1);
+	pte -= off;
+	pgoff -= off;
+
+	/*
+	 * max_pgoff is either end of page table or end of vma
+	 * or fault_around_pages() from pgoff, depending what is nearest.
+	 */
+	max_pgoff = pgoff - ((start_addr >> PAGE_SHIFT) & (PTRS_PER_PTE - 1)) +
+		PTRS_PER_PTE - 1;
+	max_pgoff = min3(max_pgoff, vma_pages(vma) + vma->vm_pgoff - 1,
+			pgoff + fault_around_pages() - 1);
+
+	/* Check if it makes any sense to call ->map_pages */
+	while (!pte_none(*pte)) {
+		if (++pgoff > max_pgoff)
+			return;
+		start_addr += PAGE_SIZE;
+		if (start_addr >= vma->vm_end)
+			return;
+		pte++;
+	}
+
+	vmf.virtual_address = (void __user *) start_addr;
+	vmf.pte = pte;
+	vmf.pgoff = pgoff;
+	vmf.max_pgoff = max_pgoff;
+	vmf.flags = flags;
+	vma->vm_ops->map_pages(vma, &vmf);
+}
+
+/**
+ * map_cached_pages - map the cached pages of a file backed range
+ * @vma:	vma to map into
+ * @start:	start of the range, page aligned and within @vma
+ * @end:	end of the range, page aligned and within @vma
+ *
+ * Maps whatever part of the range is already uptodate in the page cache,
+ * without waiting for I/O or page locks, so that exec of a hot binary
+ * does not take a minor fault per text page. At most exec_prefault_bytes
+ * from @start are mapped. Disabled together with fault-around. Caller
+ * must hold mmap_sem.
+ */
+void map_cached_pages(struct vm_area_struct *vma, unsigned long start,
+		unsigned long end)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned long addr, next;
+	struct vm_fault vmf;
+	spinlock_t *ptl;
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+	pte_t *pte;
+
+	if (!vma->vm_ops || !vma->vm_ops->map_pages ||
+	    (vma->vm_flags & VM_NONLINEAR) || fault_around_pages() <= 1)
+		return;
+
+	if (end - start > exec_prefault_bytes)
+		end = start + exec_prefault_bytes;
+
+	for (addr = start; addr < end; addr = next) {
+		next = pmd_addr_end(addr, end);
+		pgd = pgd_offset(mm, addr);
+		pud = pud_alloc(mm, pgd, addr);
+		if (!pud)
+			break;
+		pmd = pmd_alloc(mm, pud, addr);
+		if (!pmd)
+			break;
+		pte = pte_alloc_map_lock(mm, pmd, addr, &ptl);
+		if (!pte)
+			break;
+		vmf.virtual_address = (void __user *) addr;
+		vmf.pte = pte;
+		vmf.pgoff = linear_page_index(vma, addr);
+		vmf.max_pgoff = vmf.pgoff + ((next - addr) >> PAGE_SHIFT) - 1;
+		vmf.flags = 0;
+		vma->vm_ops->map_pages(vma, &vmf);
+		pte_unmap_unlock(pte, ptl);
+		cond_resched();
+	}
+}
+
 static int do_linear_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 		unsigned long address, pte_t *page_table, pmd_t *pmd,
 		unsigned int flags, pte_t orig_pte)
@@ -3488,6 +3962,23 @@ static int do_linear_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	pgoff_t pgoff = (((address & PAGE_MASK)
 			- vma->vm_start) >> PAGE_SHIFT) + vma->vm_pgoff;
 
+	/*
+	 * Let ->map_pages() map the faulting page along with its cached
+	 * neighbours; if it could not, take the slow path below.
+	 */
+	if (!(flags & FAULT_FLAG_WRITE) && vma->vm_ops->map_pages &&
+	    fault_around_pages() > 1) {
+		spinlock_t *ptl = pte_lockptr(mm, pmd);
+
+		spin_lock(ptl);
+		do_fault_around(vma, address, page_table, pgoff, flags);
+		if (!pte_same(*page_table, orig_pte)) {
+			pte_unmap_unlock(page_table, ptl);
+			return 0;
+		}
+		spin_unlock(ptl);
+	}
+
 	pte_unmap(page_table);
 	return __do_fault(mm, vma, address, pmd, pgoff, flags, orig_pte);
 }
@@ -3823,6 +4314,14 @@ retry:
 	if (pmd_numa(*pmd))
 		return do_pmd_numa_page(mm, vma, address, pmd);
 
+	/*
+	 * A pte page still shared with a forked mm has to be copied before
+	 * any of its entries can change.
+	 */
+	if (unlikely(pte_table_shared(pmd)) &&
+	    unlikely(unshare_pte_table(mm, vma, pmd, address)))
+		return VM_FAULT_OOM;
+
 	/*
 	 * Use __pte_alloc instead of pte_alloc_map, because we can't
 	 * run pte_offset_map on the pmd, if an huge pmd could
@@ -152,6 +152,12 @@ static inline unsigned long change_pmd_range(struct vm_area_struct *vma,
 		}
 		if (pmd_none_or_clear_bad(pmd))
 			continue;
+		/*
+		 * mprotect_fixup() unshares page tables shared by fork
+		 * up front; NUMA hinting just skips them.
+		 */
+		if (pte_table_shared(pmd))
+			continue;
 		pages += change_pte_range(vma, pmd, addr, next, newprot,
 				 dirty_accountable, prot_numa, &all_same_node);
 
@@ -266,6 +272,10 @@ mprotect_fixup(struct vm_area_struct *vma, struct vm_area_struct **pprev,
 		}
 	}
 
+	error = unshare_pte_tables(vma, start, end);
+	if (error)
+		goto fail;
+
 	/*
 	 * First try to merge with previous and/or next vma.
 	 */
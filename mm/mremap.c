@@ -190,6 +190,9 @@ unsigned long move_page_tables(struct vm_area_struct *vma,
 		if (pmd_none(*new_pmd) && __pte_alloc(new_vma->vm_mm, new_vma,
 						      new_pmd, new_addr))
 			break;
+		if (pte_table_shared(old_pmd) &&
+		    unshare_pte_table(vma->vm_mm, vma, old_pmd, old_addr))
+			break;
 		next = (new_addr + PMD_SIZE) & PMD_MASK;
 		if (extent > next - new_addr)
 			extent = next - new_addr;
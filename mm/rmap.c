@@ -1206,6 +1206,15 @@ int try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 		if (TTU_ACTION(flags) == TTU_MUNLOCK)
 			goto out_unmap;
 	}
+	/*
+	 * A pte page shared by fork maps the page for several mms at once:
+	 * keep it until the table has been unshared.
+	 */
+	if (IS_ENABLED(CONFIG_FORK_SHARE_PTE) &&
+	    pte_table_shared(mm_find_pmd(mm, address))) {
+		ret = SWAP_FAIL;
+		goto out_unmap;
+	}
 	if (!(flags & TTU_IGNORE_ACCESS)) {
 		if (ptep_clear_flush_young_notify(vma, address, pte)) {
 			ret = SWAP_FAIL;
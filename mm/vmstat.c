@@ -817,6 +817,10 @@ const char * const vmstat_text[] = {
 	"thp_zero_page_alloc",
 	"thp_zero_page_alloc_failed",
 #endif
+#ifdef CONFIG_FORK_SHARE_PTE
+	"pgtable_shared",
+	"pgtable_copied",
+#endif
 
 #endif /* CONFIG_VM_EVENTS_COUNTERS */
 };
@@ -92,6 +92,8 @@ static void queue_process(struct work_struct *work)
 
 		txq = netdev_get_tx_queue(dev, skb_get_queue_mapping(skb));
 
+		skb->xmit_more = 0;
+
 		local_irq_save(flags);
 		__netif_tx_lock(txq, smp_processor_id());
 		if (netif_xmit_frozen_or_stopped(txq) ||
@@ -391,6 +393,7 @@ void netpoll_send_skb_on_dev(struct netpoll *np, struct sk_buff *skb,
 						skb->vlan_tci = 0;
 					}
 
+					skb->xmit_more = 0;
 					status = ops->ndo_start_xmit(skb, dev);
 					if (status == NETDEV_TX_OK)
 						txq_trans_update(txq);
@@ -0,0 +1,190 @@
+/*
+ * Recycling of RX pages for network drivers.
+ *
+ * The pool is a ring of pages the driver handed up the stack.  Each page
+ * keeps its DMA mapping and one reference owned by the pool; when the
+ * oldest page is only referenced by the pool any more the stack is done
+ * with it and it is reused as is.  Otherwise it is released and a fresh
+ * page comes from the page allocator.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/export.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
+#include <linux/dma-mapping.h>
+#include <linux/skbuff.h>
+#include <net/page_pool.h>
+
+static inline size_t page_pool_page_size(const struct page_pool *pool)
+{
+	return PAGE_SIZE << pool->p.order;
+}
+
+static void page_pool_unmap(struct page_pool *pool, dma_addr_t dma)
+{
+	if (pool->p.dev)
+		dma_unmap_page(pool->p.dev, dma, page_pool_page_size(pool),
+			       pool->p.dma_dir);
+}
+
+/**
+ *	page_pool_create - allocate a page pool for one RX queue
+ *	@params: page order, ring size and DMA device of the pool
+ *
+ *	Returns the pool, or NULL on allocation failure.
+ */
+struct page_pool *page_pool_create(const struct page_pool_params *params)
+{
+	struct page_pool *pool;
+	unsigned int size;
+	size_t sz;
+
+	if (!params->size)
+		return NULL;
+
+	size = roundup_pow_of_two(params->size);
+	sz = sizeof(*pool) + size * sizeof(struct page_pool_entry);
+
+	pool = kzalloc(sz, GFP_KERNEL | __GFP_NOWARN);
+	if (!pool)
+		pool = vzalloc(sz);
+	if (!pool)
+		return NULL;
+
+	pool->p = *params;
+	pool->p.size = size;
+	pool->mask = size - 1;
+
+	return pool;
+}
+EXPORT_SYMBOL(page_pool_create);
+
+/**
+ *	page_pool_destroy - release the pages kept by a pool and free it
+ *	@pool: pool to destroy, may be NULL
+ *
+ *	Pages still used by the stack are freed by the stack, the pool only
+ *	drops its own reference.
+ */
+void page_pool_destroy(struct page_pool *pool)
+{
+	unsigned int i;
+
+	if (!pool)
+		return;
+
+	for (i = 0; i <= pool->mask; i++) {
+		struct page_pool_entry *e = &pool->ring[i];
+
+		if (e->page) {
+			page_pool_unmap(pool, e->dma);
+			put_page(e->page);
+		}
+	}
+
+	if (is_vmalloc_addr(pool))
+		vfree(pool);
+	else
+		kfree(pool);
+}
+EXPORT_SYMBOL(page_pool_destroy);
+
+/**
+ *	page_pool_alloc_pages - get a page for an RX buffer
+ *	@pool: pool of the RX queue
+ *	@gfp: allocation mask used when no page can be recycled
+ *	@dma: if not NULL, set to the DMA address of the page
+ *
+ *	Only the oldest page of the ring is looked at, so the cost of a
+ *	busy ring stays bounded.  The returned page has a single reference,
+ *	owned by the caller, and is synced for the device when recycled.
+ */
+struct page *page_pool_alloc_pages(struct page_pool *pool, gfp_t gfp,
+				   dma_addr_t *dma)
+{
+	struct page_pool_entry *e = &pool->ring[pool->remove & pool->mask];
+	struct page *page = e->page;
+	dma_addr_t addr = 0;
+
+	if (page) {
+		addr = e->dma;
+		e->page = NULL;
+		pool->remove++;
+
+		if (page_count(page) == 1) {
+			pool->recycled++;
+			if (pool->p.dev)
+				dma_sync_single_for_device(pool->p.dev, addr,
+						page_pool_page_size(pool),
+						pool->p.dma_dir);
+			goto out;
+		}
+
+		/* still in use, the stack will free it */
+		pool->busy++;
+		page_pool_unmap(pool, addr);
+		put_page(page);
+	}
+
+	page = __skb_alloc_pages(gfp, NULL, pool->p.order);
+	if (unlikely(!page))
+		return NULL;
+
+	if (pool->p.dev) {
+		addr = dma_map_page(pool->p.dev, page, 0,
+				    page_pool_page_size(pool), pool->p.dma_dir);
+		if (dma_mapping_error(pool->p.dev, addr)) {
+			__free_pages(page, pool->p.order);
+			return NULL;
+		}
+	}
+out:
+	if (dma)
+		*dma = addr;
+	return page;
+}
+EXPORT_SYMBOL(page_pool_alloc_pages);
+
+/**
+ *	page_pool_recycle - keep a page handed to the stack for reuse
+ *	@pool: pool of the RX queue
+ *	@page: page the caller no longer owns a reference to
+ *	@dma: DMA address of @page, as returned by page_pool_alloc_pages()
+ *
+ *	Called instead of unmapping @page once it is attached to an skb.
+ *	The pool takes a reference of its own.  Pages from the memory
+ *	reserves or a full ring are only unmapped.  So are pages from a
+ *	remote node, which are checked first: the caller may already have
+ *	released such a page.
+ */
+void page_pool_recycle(struct page_pool *pool, struct page *page,
+		       dma_addr_t dma)
+{
+	struct page_pool_entry *e = &pool->ring[pool->add & pool->mask];
+
+	if (unlikely(page_to_nid(page) != numa_node_id() ||
+		     page->pfmemalloc))
+		goto unmap;
+
+	if (unlikely(e->page)) {
+		pool->full++;
+		goto unmap;
+	}
+
+	get_page(page);
+	e->page = page;
+	e->dma = dma;
+	pool->add++;
+	return;
+
+unmap:
+	page_pool_unmap(pool, dma);
+}
+EXPORT_SYMBOL(page_pool_recycle);
@@ -38,6 +38,7 @@
 #include <linux/if_bridge.h>
 #include <linux/pci.h>
 #include <linux/etherdevice.h>
+#include <linux/filter.h>
 
 #include <asm/uaccess.h>
 
@@ -739,6 +740,15 @@ static size_t rtnl_port_size(const struct net_device *dev)
 		return port_self_size;
 }
 
+static size_t rtnl_xdp_size(const struct net_device *dev)
+{
+	if (!dev->netdev_ops->ndo_xdp)
+		return 0;
+
+	return nla_total_size(0) +	/* nest IFLA_XDP */
+	       nla_total_size(1);	/* IFLA_XDP_ATTACHED */
+}
+
 static noinline size_t if_nlmsg_size(const struct net_device *dev,
 				     u32 ext_filter_mask)
 {
@@ -766,6 +776,7 @@ static noinline size_t if_nlmsg_size(const struct net_device *dev,
 			        & RTEXT_FILTER_VF ? 4 : 0) /* IFLA_NUM_VF */
 	       + rtnl_vfinfo_size(dev, ext_filter_mask) /* IFLA_VFINFO_LIST */
 	       + rtnl_port_size(dev) /* IFLA_VF_PORTS + IFLA_PORT_SELF */
+	       + rtnl_xdp_size(dev) /* IFLA_XDP */
 	       + rtnl_link_get_size(dev) /* IFLA_LINKINFO */
 	       + rtnl_link_get_af_size(dev); /* IFLA_AF_SPEC */
 }
@@ -826,6 +837,33 @@ static int rtnl_port_self_fill(struct sk_buff *skb, struct net_device *dev)
 	return 0;
 }
 
+static int rtnl_xdp_fill(struct sk_buff *skb, struct net_device *dev)
+{
+	struct netdev_xdp xdp_op = {};
+	struct nlattr *xdp;
+	int err;
+
+	if (!dev->netdev_ops->ndo_xdp)
+		return 0;
+
+	xdp_op.command = XDP_QUERY_PROG;
+	err = dev->netdev_ops->ndo_xdp(dev, &xdp_op);
+	if (err)
+		return err;
+
+	xdp = nla_nest_start(skb, IFLA_XDP);
+	if (!xdp)
+		return -EMSGSIZE;
+
+	if (nla_put_u8(skb, IFLA_XDP_ATTACHED, xdp_op.prog_attached)) {
+		nla_nest_cancel(skb, xdp);
+		return -EMSGSIZE;
+	}
+
+	nla_nest_end(skb, xdp);
+	return 0;
+}
+
 static int rtnl_port_fill(struct sk_buff *skb, struct net_device *dev)
 {
 	int err;
@@ -988,6 +1026,9 @@ static int rtnl_fill_ifinfo(struct sk_buff *skb, struct net_device *dev,
 	if (rtnl_port_fill(skb, dev))
 		goto nla_put_failure;
 
+	if (rtnl_xdp_fill(skb, dev))
+		goto nla_put_failure;
+
 	if (dev->rtnl_link_ops) {
 		if (rtnl_link_fill(skb, dev) < 0)
 			goto nla_put_failure;
@@ -1104,6 +1145,7 @@ const struct nla_policy ifla_policy[IFLA_MAX+1] = {
 	[IFLA_PROMISCUITY]	= { .type = NLA_U32 },
 	[IFLA_NUM_TX_QUEUES]	= { .type = NLA_U32 },
 	[IFLA_NUM_RX_QUEUES]	= { .type = NLA_U32 },
+	[IFLA_XDP]		= { .type = NLA_NESTED },
 };
 EXPORT_SYMBOL(ifla_policy);
 
@@ -1112,6 +1154,13 @@ static const struct nla_policy ifla_info_policy[IFLA_INFO_MAX+1] = {
 	[IFLA_INFO_DATA]	= { .type = NLA_NESTED },
 };
 
+static const struct nla_policy ifla_xdp_policy[IFLA_XDP_MAX+1] = {
+	[IFLA_XDP_PROG]		= { .type = NLA_BINARY,
+				    .len = BPF_MAXINSNS *
+					   sizeof(struct sock_filter) },
+	[IFLA_XDP_ATTACHED]	= { .type = NLA_U8 },
+};
+
 static const struct nla_policy ifla_vfinfo_policy[IFLA_VF_INFO_MAX+1] = {
 	[IFLA_VF_INFO]		= { .type = NLA_NESTED },
 };
@@ -1283,6 +1332,46 @@ static int do_set_master(struct net_device *dev, int ifindex)
 	return 0;
 }
 
+static int do_setxdp(struct net_device *dev, struct nlattr *attr)
+{
+	const struct net_device_ops *ops = dev->netdev_ops;
+	struct nlattr *xdp[IFLA_XDP_MAX+1];
+	struct netdev_xdp xdp_op = {};
+	struct sock_fprog fprog;
+	int err;
+
+	if (!ops->ndo_xdp)
+		return -EOPNOTSUPP;
+
+	err = nla_parse_nested(xdp, IFLA_XDP_MAX, attr, ifla_xdp_policy);
+	if (err < 0)
+		return err;
+
+	if (xdp[IFLA_XDP_ATTACHED])
+		return -EINVAL;
+	if (!xdp[IFLA_XDP_PROG])
+		return 0;
+
+	if (nla_len(xdp[IFLA_XDP_PROG]) % sizeof(struct sock_filter))
+		return -EINVAL;
+
+	xdp_op.command = XDP_SETUP_PROG;
+	fprog.len = nla_len(xdp[IFLA_XDP_PROG]) / sizeof(struct sock_filter);
+	if (fprog.len) {
+		fprog.filter = nla_data(xdp[IFLA_XDP_PROG]);
+		err = sk_unattached_filter_create(&xdp_op.prog, &fprog);
+		if (err)
+			return err;
+	}
+
+	/* On success the driver owns the program. */
+	err = ops->ndo_xdp(dev, &xdp_op);
+	if (err && xdp_op.prog)
+		sk_unattached_filter_destroy(xdp_op.prog);
+
+	return err;
+}
+
 static int do_setlink(struct net_device *dev, struct ifinfomsg *ifm,
 		      struct nlattr **tb, char *ifname, int modified)
 {
@@ -1424,6 +1513,13 @@ static int do_setlink(struct net_device *dev, struct ifinfomsg *ifm,
 		write_unlock_bh(&dev_base_lock);
 	}
 
+	if (tb[IFLA_XDP]) {
+		err = do_setxdp(dev, tb[IFLA_XDP]);
+		if (err)
+			goto errout;
+		modified = 1;
+	}
+
 	if (tb[IFLA_VFINFO_LIST]) {
 		struct nlattr *attr;
 		int rem;
@@ -43,6 +43,7 @@
 #include <linux/kernel.h>
 #include <linux/kmemcheck.h>
 #include <linux/mm.h>
+#include <linux/sched.h>
 #include <linux/interrupt.h>
 #include <linux/in.h>
 #include <linux/inet.h>
@@ -523,13 +524,7 @@ static void skb_release_data(struct sk_buff *skb)
 		 * If skb buf is from userspace, we need to notify the caller
 		 * the lower device DMA has done;
 		 */
-		if (skb_shinfo(skb)->tx_flags & SKBTX_DEV_ZEROCOPY) {
-			struct ubuf_info *uarg;
-
-			uarg = skb_shinfo(skb)->destructor_arg;
-			if (uarg->callback)
-				uarg->callback(uarg, true);
-		}
+		skb_zcopy_clear(skb, true);
 
 		if (skb_has_frag_list(skb))
 			skb_drop_fraglist(skb);
@@ -664,14 +659,7 @@ EXPORT_SYMBOL(kfree_skb_list);
  */
 void skb_tx_error(struct sk_buff *skb)
 {
-	if (skb_shinfo(skb)->tx_flags & SKBTX_DEV_ZEROCOPY) {
-		struct ubuf_info *uarg;
-
-		uarg = skb_shinfo(skb)->destructor_arg;
-		if (uarg->callback)
-			uarg->callback(uarg, false);
-		skb_shinfo(skb)->tx_flags &= ~SKBTX_DEV_ZEROCOPY;
-	}
+	skb_zcopy_clear(skb, false);
 }
 EXPORT_SYMBOL(skb_tx_error);
 
@@ -712,6 +700,7 @@ static void __copy_skb_header(struct sk_buff *new, const struct sk_buff *old)
 	new->l4_rxhash		= old->l4_rxhash;
 	new->no_fcs		= old->no_fcs;
 	new->encapsulation	= old->encapsulation;
+	new->xmit_more		= 0;
 #ifdef CONFIG_XFRM
 	new->sp			= secpath_get(old->sp);
 #endif
@@ -743,6 +732,10 @@ static void __copy_skb_header(struct sk_buff *new, const struct sk_buff *old)
 	new->vlan_tci		= old->vlan_tci;
 
 	skb_copy_secmark(new, old);
+
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	new->napi_id	= old->napi_id;
+#endif
 }
 
 /*
@@ -816,7 +809,6 @@ int skb_copy_ubufs(struct sk_buff *skb, gfp_t gfp_mask)
 	int i;
 	int num_frags = skb_shinfo(skb)->nr_frags;
 	struct page *page, *head = NULL;
-	struct ubuf_info *uarg = skb_shinfo(skb)->destructor_arg;
 
 	for (i = 0; i < num_frags; i++) {
 		u8 *vaddr;
@@ -843,7 +835,7 @@ int skb_copy_ubufs(struct sk_buff *skb, gfp_t gfp_mask)
 	for (i = 0; i < num_frags; i++)
 		skb_frag_unref(skb, i);
 
-	uarg->callback(uarg, false);
+	skb_zcopy_clear(skb, false);
 
 	/* skb frags point to kernel buffers */
 	for (i = num_frags - 1; i >= 0; i--) {
@@ -852,11 +844,385 @@ int skb_copy_ubufs(struct sk_buff *skb, gfp_t gfp_mask)
 		head = (struct page *)head->private;
 	}
 
-	skb_shinfo(skb)->tx_flags &= ~SKBTX_DEV_ZEROCOPY;
 	return 0;
 }
 EXPORT_SYMBOL_GPL(skb_copy_ubufs);
 
+/* Charge pinned user pages to RLIMIT_MEMLOCK, as done for locked memory. */
+static int mm_account_pinned_pages(struct mmpin *mmp, size_t size)
+{
+	unsigned long max_pg, num_pg, new_pg, old_pg;
+	struct user_struct *user;
+
+	if (capable(CAP_IPC_LOCK) || !size)
+		return 0;
+
+	num_pg = (size >> PAGE_SHIFT) + 2;	/* worst case */
+	max_pg = rlimit(RLIMIT_MEMLOCK) >> PAGE_SHIFT;
+	user = mmp->user ? : current_user();
+
+	do {
+		old_pg = atomic_long_read(&user->locked_vm);
+		new_pg = old_pg + num_pg;
+		if (new_pg > max_pg)
+			return -ENOBUFS;
+	} while (atomic_long_cmpxchg(&user->locked_vm, old_pg, new_pg) !=
+		 old_pg);
+
+	if (!mmp->user) {
+		mmp->user = get_uid(user);
+		mmp->num_pg = num_pg;
+	} else {
+		mmp->num_pg += num_pg;
+	}
+
+	return 0;
+}
+
+static void mm_unaccount_pinned_pages(struct mmpin *mmp)
+{
+	if (mmp->user) {
+		atomic_long_sub(mmp->num_pg, &mmp->user->locked_vm);
+		free_uid(mmp->user);
+	}
+}
+
+/* The ubuf_info of a MSG_ZEROCOPY send lives in the cb of the skb that
+ * later carries its completion notification on the error queue.
+ */
+static struct sk_buff *skb_from_uarg(struct ubuf_info *uarg)
+{
+	return container_of((void *)uarg, struct sk_buff, cb);
+}
+
+/**
+ *	sock_zerocopy_alloc - start tracking the pages of a MSG_ZEROCOPY send
+ *	@sk: sending socket
+ *	@size: length of the send
+ *
+ *	Returns a ubuf_info with one reference owned by the caller, which
+ *	drops it with sock_zerocopy_put() once every skb took its own, or
+ *	NULL if the socket is out of option memory or the user out of
+ *	RLIMIT_MEMLOCK.
+ */
+struct ubuf_info *sock_zerocopy_alloc(struct sock *sk, size_t size)
+{
+	struct ubuf_info *uarg;
+	struct sk_buff *skb;
+
+	skb = sock_omalloc(sk, 0, GFP_KERNEL);
+	if (!skb)
+		return NULL;
+
+	BUILD_BUG_ON(sizeof(*uarg) > sizeof(skb->cb));
+	uarg = (void *)skb->cb;
+	uarg->mmp.user = NULL;
+
+	if (mm_account_pinned_pages(&uarg->mmp, size)) {
+		kfree_skb(skb);
+		return NULL;
+	}
+
+	uarg->callback = sock_zerocopy_callback;
+	uarg->id = ((u32)atomic_inc_return(&sk->sk_zckey)) - 1;
+	uarg->len = 1;
+	uarg->bytelen = size;
+	uarg->zerocopy = 1;
+	atomic_set(&uarg->refcnt, 1);
+	sock_hold(sk);
+
+	return uarg;
+}
+EXPORT_SYMBOL_GPL(sock_zerocopy_alloc);
+
+/**
+ *	sock_zerocopy_realloc - extend a ubuf_info to the next send
+ *	@sk: sending socket, owned by the caller
+ *	@size: length of the send
+ *	@uarg: ubuf_info of the skb the send will append to, or NULL
+ *
+ *	Consecutive sends appending to the same skb share its ubuf_info, so
+ *	that one notification covers their whole range of ids.
+ */
+struct ubuf_info *sock_zerocopy_realloc(struct sock *sk, size_t size,
+					struct ubuf_info *uarg)
+{
+	if (uarg) {
+		const u32 byte_limit = 1 << 19;		/* limit to a few TSO */
+		u32 bytelen, next;
+
+		/* sk_zckey and uarg->len are serialized by the socket lock */
+		if (!sock_owned_by_user(sk)) {
+			WARN_ON_ONCE(1);
+			return NULL;
+		}
+
+		bytelen = uarg->bytelen + size;
+		if (uarg->len == USHRT_MAX - 1 || bytelen > byte_limit) {
+			/* TCP can create new skb to attach new uarg */
+			if (sk->sk_type == SOCK_STREAM)
+				goto new_alloc;
+			return NULL;
+		}
+
+		next = (u32)atomic_read(&sk->sk_zckey);
+		if ((u32)(uarg->id + uarg->len) == next) {
+			if (mm_account_pinned_pages(&uarg->mmp, size))
+				return NULL;
+			uarg->len++;
+			uarg->bytelen = bytelen;
+			atomic_set(&sk->sk_zckey, ++next);
+			sock_zerocopy_get(uarg);
+			return uarg;
+		}
+	}
+
+new_alloc:
+	return sock_zerocopy_alloc(sk, size);
+}
+EXPORT_SYMBOL_GPL(sock_zerocopy_realloc);
+
+static bool skb_zerocopy_notify_extend(struct sk_buff *skb, u32 lo, u16 len,
+				       u8 code)
+{
+	struct sock_exterr_skb *serr = SKB_EXT_ERR(skb);
+	u32 old_lo, old_hi;
+	u64 sum_len;
+
+	old_lo = serr->ee.ee_info;
+	old_hi = serr->ee.ee_data;
+	sum_len = old_hi - old_lo + 1ULL + len;
+
+	if (sum_len >= (1ULL << 32))
+		return false;
+
+	if (lo != old_hi + 1 || serr->ee.ee_code != code)
+		return false;
+
+	serr->ee.ee_data += len;
+	return true;
+}
+
+/**
+ *	sock_zerocopy_callback - queue the completion of a MSG_ZEROCOPY range
+ *	@uarg: ubuf_info whose last reference was dropped
+ *	@success: false if the data had to be copied at some point
+ *
+ *	Notifications are merged with the one at the tail of the error queue
+ *	when their ranges are contiguous, so a reader that falls behind
+ *	finds few large ranges rather than one entry per send.
+ */
+void sock_zerocopy_callback(struct ubuf_info *uarg, bool success)
+{
+	struct sk_buff *tail, *skb = skb_from_uarg(uarg);
+	struct sock_exterr_skb *serr;
+	struct sock *sk = skb->sk;
+	struct sk_buff_head *q;
+	unsigned long flags;
+	u32 lo, hi;
+	u16 len;
+	u8 code;
+
+	mm_unaccount_pinned_pages(&uarg->mmp);
+
+	/* if !len, there was only 1 call, and it was aborted
+	 * so do not queue a completion notification
+	 */
+	if (!uarg->len || sock_flag(sk, SOCK_DEAD))
+		goto release;
+
+	len = uarg->len;
+	lo = uarg->id;
+	hi = uarg->id + len - 1;
+	code = success ? 0 : SO_EE_CODE_ZEROCOPY_COPIED;
+
+	serr = SKB_EXT_ERR(skb);
+	memset(serr, 0, sizeof(*serr));
+	serr->ee.ee_errno = 0;
+	serr->ee.ee_origin = SO_EE_ORIGIN_ZEROCOPY;
+	serr->ee.ee_code = code;
+	serr->ee.ee_data = hi;
+	serr->ee.ee_info = lo;
+
+	q = &sk->sk_error_queue;
+	spin_lock_irqsave(&q->lock, flags);
+	tail = skb_peek_tail(q);
+	if (!tail || SKB_EXT_ERR(tail)->ee.ee_origin != SO_EE_ORIGIN_ZEROCOPY ||
+	    !skb_zerocopy_notify_extend(tail, lo, len, code)) {
+		__skb_queue_tail(q, skb);
+		skb = NULL;
+	}
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	sk->sk_error_report(sk);
+
+release:
+	consume_skb(skb);
+	sock_put(sk);
+}
+EXPORT_SYMBOL_GPL(sock_zerocopy_callback);
+
+void sock_zerocopy_put(struct ubuf_info *uarg)
+{
+	if (uarg && atomic_dec_and_test(&uarg->refcnt)) {
+		if (uarg->callback)
+			uarg->callback(uarg, uarg->zerocopy);
+		else
+			consume_skb(skb_from_uarg(uarg));
+	}
+}
+EXPORT_SYMBOL_GPL(sock_zerocopy_put);
+
+/* Undo sock_zerocopy_realloc() for a send that failed without data. */
+void sock_zerocopy_put_abort(struct ubuf_info *uarg)
+{
+	if (uarg) {
+		struct sock *sk = skb_from_uarg(uarg)->sk;
+
+		atomic_dec(&sk->sk_zckey);
+		uarg->len--;
+
+		sock_zerocopy_put(uarg);
+	}
+}
+EXPORT_SYMBOL_GPL(sock_zerocopy_put_abort);
+
+/* Pin up to @len bytes of user memory at @from and append them to the frags
+ * of @skb.  Returns the number of bytes appended, short if the frags run
+ * out, or -EMSGSIZE if none is left and -EFAULT if nothing could be pinned.
+ */
+static int __skb_zerocopy_from_user(struct sk_buff *skb,
+				    const void __user *from, int len)
+{
+	struct page *pages[MAX_SKB_FRAGS];
+	unsigned long addr = (unsigned long)from;
+	int frag = skb_shinfo(skb)->nr_frags;
+	int off = addr & ~PAGE_MASK;
+	int copied = 0;
+	int i, n;
+
+	if (frag == MAX_SKB_FRAGS)
+		return -EMSGSIZE;
+
+	len = min_t(int, len, (MAX_SKB_FRAGS - frag) * PAGE_SIZE - off);
+	n = get_user_pages_fast(addr, DIV_ROUND_UP(off + len, PAGE_SIZE), 0,
+				pages);
+	if (n <= 0)
+		return -EFAULT;
+
+	for (i = 0; i < n; i++) {
+		int size = min_t(int, len - copied, PAGE_SIZE - off);
+
+		if (skb_can_coalesce(skb, frag, pages[i], off)) {
+			skb_frag_size_add(&skb_shinfo(skb)->frags[frag - 1],
+					  size);
+			put_page(pages[i]);
+		} else {
+			skb_fill_page_desc(skb, frag++, pages[i], off, size);
+		}
+		copied += size;
+		off = 0;
+	}
+
+	skb->len += copied;
+	skb->data_len += copied;
+	skb->truesize += copied;
+
+	return copied;
+}
+
+/**
+ *	skb_zerocopy_stream - append user pages to an skb of a stream socket
+ *	@sk: socket owning @skb, locked
+ *	@skb: skb at the tail of the write queue
+ *	@from: user data
+ *	@len: length of the user data
+ *	@uarg: ubuf_info of the send
+ *
+ *	Returns the number of bytes appended, which may be less than @len, or
+ *	-EEXIST if @skb belongs to another ubuf_info, -EMSGSIZE if it has no
+ *	frag left; the caller then moves on to a new skb.
+ */
+int skb_zerocopy_stream(struct sock *sk, struct sk_buff *skb,
+			const void __user *from, int len,
+			struct ubuf_info *uarg)
+{
+	struct ubuf_info *orig_uarg = skb_zcopy(skb);
+	int copied;
+
+	if (orig_uarg && uarg != orig_uarg)
+		return -EEXIST;
+
+	copied = __skb_zerocopy_from_user(skb, from, len);
+	if (copied < 0)
+		return copied;
+
+	sk->sk_wmem_queued += copied;
+	sk_mem_charge(sk, copied);
+	skb_zcopy_set(skb, uarg);
+
+	return copied;
+}
+EXPORT_SYMBOL_GPL(skb_zerocopy_stream);
+
+/**
+ *	skb_zerocopy_dgram - append user pages to a datagram skb
+ *	@skb: skb owned by the sending socket
+ *	@iov: user data
+ *	@offset: offset in @iov of the data to append
+ *	@len: length of the data to append
+ *	@uarg: ubuf_info of the send
+ *
+ *	Returns the number of bytes appended, or a negative error if none was.
+ */
+int skb_zerocopy_dgram(struct sk_buff *skb, const struct iovec *iov,
+		       int offset, int len, struct ubuf_info *uarg)
+{
+	int copied = 0, err = 0;
+
+	while (len > 0) {
+		int n, seglen;
+
+		if (offset >= iov->iov_len) {
+			offset -= iov->iov_len;
+			iov++;
+			continue;
+		}
+
+		seglen = min_t(int, len, iov->iov_len - offset);
+		n = __skb_zerocopy_from_user(skb, iov->iov_base + offset,
+					     seglen);
+		if (n < 0) {
+			err = n;
+			break;
+		}
+
+		copied += n;
+		offset += n;
+		len -= n;
+		if (n < seglen)
+			break;
+	}
+
+	if (!copied)
+		return err;
+
+	atomic_add(copied, &skb->sk->sk_wmem_alloc);
+	skb_zcopy_set(skb, uarg);
+
+	return copied;
+}
+EXPORT_SYMBOL_GPL(skb_zerocopy_dgram);
+
+/* Make @nskb hold the MSG_ZEROCOPY pages it shares with @orig. */
+static void skb_zerocopy_clone(struct sk_buff *nskb, struct sk_buff *orig)
+{
+	struct ubuf_info *uarg = skb_zcopy(orig);
+
+	if (uarg && uarg->callback == sock_zerocopy_callback)
+		skb_zcopy_set(nskb, uarg);
+}
+
 /**
  *	skb_clone	-	duplicate an sk_buff
  *	@skb: buffer to clone
@@ -1026,6 +1392,7 @@ struct sk_buff *__pskb_copy(struct sk_buff *skb, int headroom, gfp_t gfp_mask)
 			skb_frag_ref(skb, i);
 		}
 		skb_shinfo(n)->nr_frags = i;
+		skb_zerocopy_clone(n, skb);
 	}
 
 	if (skb_has_frag_list(skb)) {
@@ -1096,6 +1463,9 @@ int pskb_expand_head(struct sk_buff *skb, int nhead, int ntail,
 		/* copy this zero copy skb frags */
 		if (skb_orphan_frags(skb, gfp_mask))
 			goto nofrags;
+		/* the new shinfo holds its own reference on MSG_ZEROCOPY pages */
+		if (skb_zcopy(skb))
+			sock_zerocopy_get(skb_uarg(skb));
 		for (i = 0; i < skb_shinfo(skb)->nr_frags; i++)
 			skb_frag_ref(skb, i);
 
@@ -2356,6 +2726,7 @@ void skb_split(struct sk_buff *skb, struct sk_buff *skb1, const u32 len)
 	int pos = skb_headlen(skb);
 
 	skb_shinfo(skb1)->tx_flags = skb_shinfo(skb)->tx_flags & SKBTX_SHARED_FRAG;
+	skb_zerocopy_clone(skb1, skb);
 	if (len < pos)	/* Split line is inside header. */
 		skb_split_inside_header(skb, skb1, len, pos);
 	else		/* Second chunk has no header, nothing to copy. */
@@ -2398,6 +2769,10 @@ int skb_shift(struct sk_buff *tgt, struct sk_buff *skb, int shiftlen)
 	BUG_ON(shiftlen > skb->len);
 	BUG_ON(skb_headlen(skb));	/* Would corrupt stream */
 
+	/* frags of different MSG_ZEROCOPY sends must not be mixed */
+	if (skb_zcopy(tgt) || skb_zcopy(skb))
+		return 0;
+
 	todo = shiftlen;
 	from = 0;
 	to = skb_shinfo(tgt)->nr_frags;
@@ -2873,6 +3248,7 @@ struct sk_buff *skb_segment(struct sk_buff *skb, netdev_features_t features)
 						 skb_put(nskb, hsize), hsize);
 
 		skb_shinfo(nskb)->tx_flags = skb_shinfo(skb)->tx_flags & SKBTX_SHARED_FRAG;
+		skb_zerocopy_clone(nskb, skb);
 
 		while (pos < offset + len && i < nfrags) {
 			*frag = skb_shinfo(skb)->frags[i];
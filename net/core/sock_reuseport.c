@@ -0,0 +1,281 @@
+/*
+ * SO_REUSEPORT groups.
+ *
+ * To speed up socket lookup, all sockets bound to the same address and
+ * port with SO_REUSEPORT are kept in an array.  This allows a decision to
+ * be made after finding the first socket of the group, instead of
+ * scoring every socket of the hash chain.
+ */
+
+#include <linux/kernel.h>
+#include <linux/export.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/ipv6.h>
+#include <net/inet_sock.h>
+#include <net/ipv6.h>
+#include <net/sock_reuseport.h>
+
+#define INIT_SOCKS 128
+
+static DEFINE_SPINLOCK(reuseport_lock);
+
+static struct sock_reuseport *__reuseport_alloc(u16 max_socks)
+{
+	size_t size = sizeof(struct sock_reuseport) +
+		      sizeof(struct sock *) * max_socks;
+	struct sock_reuseport *reuse = kzalloc(size, GFP_ATOMIC);
+
+	if (!reuse)
+		return NULL;
+
+	reuse->max_socks = max_socks;
+
+	return reuse;
+}
+
+int reuseport_alloc(struct sock *sk)
+{
+	struct sock_reuseport *reuse;
+
+	/* bh lock used since this function call may precede hlist lock in
+	 * soft irq of receive path or setsockopt from process context
+	 */
+	spin_lock_bh(&reuseport_lock);
+	if (rcu_dereference_protected(sk->sk_reuseport_cb,
+				      lockdep_is_held(&reuseport_lock))) {
+		spin_unlock_bh(&reuseport_lock);
+		return 0;
+	}
+
+	reuse = __reuseport_alloc(INIT_SOCKS);
+	if (!reuse) {
+		spin_unlock_bh(&reuseport_lock);
+		return -ENOMEM;
+	}
+
+	reuse->socks[0] = sk;
+	reuse->num_socks = 1;
+	rcu_assign_pointer(sk->sk_reuseport_cb, reuse);
+
+	spin_unlock_bh(&reuseport_lock);
+
+	return 0;
+}
+EXPORT_SYMBOL(reuseport_alloc);
+
+static struct sock_reuseport *reuseport_grow(struct sock_reuseport *reuse)
+{
+	struct sock_reuseport *more_reuse;
+	u32 more_socks_size, i;
+
+	more_socks_size = reuse->max_socks * 2U;
+	if (more_socks_size > USHRT_MAX)
+		more_socks_size = USHRT_MAX;
+
+	if (more_socks_size == reuse->max_socks)
+		return NULL;
+
+	more_reuse = __reuseport_alloc(more_socks_size);
+	if (!more_reuse)
+		return NULL;
+
+	more_reuse->max_socks = more_socks_size;
+	more_reuse->num_socks = reuse->num_socks;
+	more_reuse->has_conns = reuse->has_conns;
+
+	memcpy(more_reuse->socks, reuse->socks,
+	       reuse->num_socks * sizeof(struct sock *));
+
+	for (i = 0; i < reuse->num_socks; ++i)
+		rcu_assign_pointer(reuse->socks[i]->sk_reuseport_cb,
+				   more_reuse);
+
+	/* lockless readers may still walk the old array */
+	kfree_rcu(reuse, rcu);
+	return more_reuse;
+}
+
+/**
+ *  reuseport_add_sock - Add a socket to the reuseport group of another.
+ *  @sk:  New socket to add to the group.
+ *  @sk2: Socket belonging to the existing reuseport group.
+ *  May return ENOMEM and not add socket to group under memory pressure.
+ */
+int reuseport_add_sock(struct sock *sk, struct sock *sk2)
+{
+	struct sock_reuseport *reuse;
+
+	if (!rcu_access_pointer(sk2->sk_reuseport_cb)) {
+		int err = reuseport_alloc(sk2);
+
+		if (err)
+			return err;
+	}
+
+	spin_lock_bh(&reuseport_lock);
+	reuse = rcu_dereference_protected(sk2->sk_reuseport_cb,
+					  lockdep_is_held(&reuseport_lock));
+	WARN_ONCE(rcu_dereference_protected(sk->sk_reuseport_cb,
+					    lockdep_is_held(&reuseport_lock)),
+		  "socket already in reuseport group");
+
+	if (reuse->num_socks == reuse->max_socks) {
+		reuse = reuseport_grow(reuse);
+		if (!reuse) {
+			spin_unlock_bh(&reuseport_lock);
+			return -ENOMEM;
+		}
+	}
+
+	reuse->socks[reuse->num_socks] = sk;
+	/* paired with smp_rmb() in reuseport_select_sock() */
+	smp_wmb();
+	reuse->num_socks++;
+	rcu_assign_pointer(sk->sk_reuseport_cb, reuse);
+
+	spin_unlock_bh(&reuseport_lock);
+
+	return 0;
+}
+EXPORT_SYMBOL(reuseport_add_sock);
+
+void reuseport_detach_sock(struct sock *sk)
+{
+	struct sock_reuseport *reuse;
+	int i;
+
+	spin_lock_bh(&reuseport_lock);
+	reuse = rcu_dereference_protected(sk->sk_reuseport_cb,
+					  lockdep_is_held(&reuseport_lock));
+	if (!reuse)
+		goto out;
+
+	rcu_assign_pointer(sk->sk_reuseport_cb, NULL);
+
+	for (i = 0; i < reuse->num_socks; i++) {
+		if (reuse->socks[i] == sk) {
+			reuse->socks[i] = reuse->socks[reuse->num_socks - 1];
+			reuse->num_socks--;
+			if (reuse->num_socks == 0)
+				kfree_rcu(reuse, rcu);
+			break;
+		}
+	}
+out:
+	spin_unlock_bh(&reuseport_lock);
+}
+EXPORT_SYMBOL(reuseport_detach_sock);
+
+/**
+ *  reuseport_select_sock - Select a socket from an SO_REUSEPORT group.
+ *  @sk: First socket in the group.
+ *  @hash: Flow hash used to pick a member.
+ *  Returns a socket that should receive the packet (or NULL on error).
+ *
+ *  Must be called under rcu_read_lock().  Sockets are SLAB_DESTROY_BY_RCU,
+ *  so the caller still has to take a reference and revalidate the
+ *  returned socket, as it does for a socket found by walking a chain.
+ */
+struct sock *reuseport_select_sock(struct sock *sk, u32 hash)
+{
+	struct sock_reuseport *reuse;
+	struct sock *sk2 = NULL;
+	u16 socks;
+
+	reuse = rcu_dereference(sk->sk_reuseport_cb);
+
+	/* if memory allocation failed or add call is not yet complete */
+	if (!reuse)
+		return NULL;
+
+	socks = ACCESS_ONCE(reuse->num_socks);
+	if (likely(socks)) {
+		/* paired with smp_wmb() in reuseport_add_sock() */
+		smp_rmb();
+
+		sk2 = reuse->socks[((u64)hash * socks) >> 32];
+	}
+	return sk2;
+}
+EXPORT_SYMBOL(reuseport_select_sock);
+
+/**
+ *  reuseport_saddr_equal - Do two sockets share their bound address ?
+ *  @sk: socket being bound
+ *  @sk2: candidate member of an existing group
+ *
+ *  Unlike the bind conflict helpers, a wildcard address only matches
+ *  another wildcard address: a group never mixes sockets that would
+ *  score differently in a lookup.
+ */
+bool reuseport_saddr_equal(const struct sock *sk, const struct sock *sk2)
+{
+	if (sk->sk_family != sk2->sk_family)
+		return false;
+#if IS_ENABLED(CONFIG_IPV6)
+	if (sk->sk_family == AF_INET6)
+		return ipv6_only_sock(sk) == ipv6_only_sock(sk2) &&
+		       ipv6_addr_equal(&inet6_sk(sk)->rcv_saddr,
+				       &inet6_sk(sk2)->rcv_saddr);
+#endif
+	return inet_sk(sk)->inet_rcv_saddr == inet_sk(sk2)->inet_rcv_saddr;
+}
+EXPORT_SYMBOL(reuseport_saddr_equal);
+
+/**
+ *  reuseport_sock_rank - Lookup score of a socket before it connects.
+ *  @sk: socket being hashed
+ *
+ *  Listener and UDP lookups score the family, a bound address and a
+ *  bound device.  The rank gives them the same weights, so a socket of
+ *  higher rank never scores below one of lower rank for a packet that
+ *  both of them match.
+ */
+int reuseport_sock_rank(const struct sock *sk)
+{
+	int rank = sk->sk_family == PF_INET ? 2 : 1;
+
+	if (sk->sk_bound_dev_if)
+		rank += 4;
+#if IS_ENABLED(CONFIG_IPV6)
+	if (sk->sk_family == AF_INET6) {
+		if (!ipv6_addr_any(&inet6_sk(sk)->rcv_saddr))
+			rank += 4;
+		return rank;
+	}
+#endif
+	if (inet_sk(sk)->inet_rcv_saddr)
+		rank += 4;
+	return rank;
+}
+EXPORT_SYMBOL(reuseport_sock_rank);
+
+/**
+ *  reuseport_add_node_rcu - Hash a socket, keeping the chain sorted by rank.
+ *  @sk: socket to add, no reference is taken
+ *  @list: chain linked through sk_nulls_node
+ *
+ *  The socket goes ahead of the sockets of equal or lower rank, so the
+ *  first member of a SO_REUSEPORT group met by a lookup follows every
+ *  socket that could score higher, and the group can be picked from
+ *  right away.  Called with the chain lock held.
+ */
+void reuseport_add_node_rcu(struct sock *sk, struct hlist_nulls_head *list)
+{
+	struct hlist_nulls_node *node, *prev = NULL;
+	int rank = reuseport_sock_rank(sk);
+	struct sock *sk2;
+
+	sk_nulls_for_each(sk2, node, list) {
+		if (reuseport_sock_rank(sk2) <= rank)
+			break;
+		prev = &sk2->sk_nulls_node;
+	}
+
+	if (prev)
+		hlist_nulls_add_after_rcu(prev, &sk->sk_nulls_node);
+	else
+		hlist_nulls_add_head_rcu(&sk->sk_nulls_node, list);
+}
+EXPORT_SYMBOL(reuseport_add_node_rcu);
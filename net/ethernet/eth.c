@@ -425,3 +425,109 @@ ssize_t sysfs_format_mac(char *buf, const unsigned char *addr, int len)
 	return (ssize_t)l;
 }
 EXPORT_SYMBOL(sysfs_format_mac);
+
+/**
+ * eth_gro_receive - merge packets behind an inner Ethernet header
+ * @head: list of skbs held by GRO
+ * @skb: new packet, with the GRO offset at the Ethernet header
+ *
+ * Used by tunnels carrying Ethernet frames (VXLAN, transparent Ethernet
+ * bridging over GRE) to hand the inner packet to its protocol.
+ */
+struct sk_buff **eth_gro_receive(struct sk_buff **head, struct sk_buff *skb)
+{
+	struct packet_offload *ptype;
+	struct sk_buff **pp = NULL;
+	struct ethhdr *eh, *eh2;
+	unsigned int hlen, off;
+	struct sk_buff *p;
+	int flush = 1;
+	__wsum csum;
+
+	off = skb_gro_offset(skb);
+	hlen = off + sizeof(*eh);
+	eh = skb_gro_header_fast(skb, off);
+	if (skb_gro_header_hard(skb, hlen)) {
+		eh = skb_gro_header_slow(skb, hlen, off);
+		if (unlikely(!eh))
+			goto out;
+	}
+
+	flush = 0;
+
+	for (p = *head; p; p = p->next) {
+		if (!NAPI_GRO_CB(p)->same_flow)
+			continue;
+
+		eh2 = (struct ethhdr *)(p->data + off);
+		if (compare_ether_header(eh, eh2)) {
+			NAPI_GRO_CB(p)->same_flow = 0;
+			continue;
+		}
+	}
+
+	rcu_read_lock();
+	ptype = gro_find_receive_by_type(eh->h_proto);
+	if (!ptype) {
+		flush = 1;
+		goto out_unlock;
+	}
+
+	skb_gro_pull(skb, sizeof(*eh));
+
+	csum = skb->csum;
+	skb_postpull_rcsum(skb, eh, sizeof(*eh));
+
+	pp = ptype->callbacks.gro_receive(head, skb);
+
+	skb->csum = csum;
+
+out_unlock:
+	rcu_read_unlock();
+out:
+	NAPI_GRO_CB(skb)->flush |= flush;
+
+	return pp;
+}
+EXPORT_SYMBOL(eth_gro_receive);
+
+/**
+ * eth_gro_complete - finish a packet merged by eth_gro_receive()
+ * @skb: merged packet
+ * @nhoff: offset of the inner Ethernet header
+ */
+int eth_gro_complete(struct sk_buff *skb, int nhoff)
+{
+	struct ethhdr *eh = (struct ethhdr *)(skb->data + nhoff);
+	struct packet_offload *ptype;
+	int err = -ENOSYS;
+
+	if (skb->encapsulation)
+		skb_set_inner_mac_header(skb, nhoff);
+
+	rcu_read_lock();
+	ptype = gro_find_complete_by_type(eh->h_proto);
+	if (ptype)
+		err = ptype->callbacks.gro_complete(skb, nhoff + sizeof(*eh));
+	rcu_read_unlock();
+
+	return err;
+}
+EXPORT_SYMBOL(eth_gro_complete);
+
+static struct packet_offload eth_packet_offload __read_mostly = {
+	.type = cpu_to_be16(ETH_P_TEB),
+	.callbacks = {
+		.gro_receive = eth_gro_receive,
+		.gro_complete = eth_gro_complete,
+	},
+};
+
+static int __init eth_offload_init(void)
+{
+	dev_add_offload(&eth_packet_offload);
+
+	return 0;
+}
+
+fs_initcall(eth_offload_init);
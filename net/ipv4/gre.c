@@ -207,6 +207,119 @@ static int gre_gso_send_check(struct sk_buff *skb)
 	return 0;
 }
 
+/*
+ * Only version 0 headers with an optional key are merged: a sequence
+ * number cannot be rebuilt by gre_gso_segment() when the merged packet
+ * is forwarded, and a GRE checksum would have to be verified here.
+ */
+static struct sk_buff **gre_gro_receive(struct sk_buff **head,
+					struct sk_buff *skb)
+{
+	const struct gre_base_hdr *greh;
+	struct packet_offload *ptype;
+	struct sk_buff **pp = NULL;
+	unsigned int hlen, off;
+	int grehlen = sizeof(*greh);
+	struct sk_buff *p;
+	int flush = 1;
+	__wsum csum;
+
+	if (NAPI_GRO_CB(skb)->encap_mark)
+		goto out;
+
+	off = skb_gro_offset(skb);
+	hlen = off + sizeof(*greh);
+	greh = skb_gro_header_fast(skb, off);
+	if (skb_gro_header_hard(skb, hlen)) {
+		greh = skb_gro_header_slow(skb, hlen, off);
+		if (unlikely(!greh))
+			goto out;
+	}
+
+	if ((greh->flags & ~GRE_KEY) != 0)
+		goto out;
+
+	if (greh->flags & GRE_KEY) {
+		grehlen += GRE_HEADER_SECTION;
+		hlen = off + grehlen;
+		if (skb_gro_header_hard(skb, hlen)) {
+			greh = skb_gro_header_slow(skb, hlen, off);
+			if (unlikely(!greh))
+				goto out;
+		}
+	}
+
+	rcu_read_lock();
+	ptype = gro_find_receive_by_type(greh->protocol);
+	if (!ptype)
+		goto out_unlock;
+
+	flush = 0;
+	NAPI_GRO_CB(skb)->encap_mark = 1;
+
+	for (p = *head; p; p = p->next) {
+		const struct gre_base_hdr *greh2;
+
+		if (!NAPI_GRO_CB(p)->same_flow)
+			continue;
+
+		greh2 = (struct gre_base_hdr *)(p->data + off);
+		if (greh2->flags != greh->flags ||
+		    greh2->protocol != greh->protocol) {
+			NAPI_GRO_CB(p)->same_flow = 0;
+			continue;
+		}
+
+		if ((greh->flags & GRE_KEY) &&
+		    *(__be32 *)(greh2 + 1) != *(__be32 *)(greh + 1)) {
+			NAPI_GRO_CB(p)->same_flow = 0;
+			continue;
+		}
+	}
+
+	skb_gro_pull(skb, grehlen);
+
+	csum = skb->csum;
+	skb_postpull_rcsum(skb, greh, grehlen);
+
+	pp = ptype->callbacks.gro_receive(head, skb);
+
+	skb->csum = csum;
+
+out_unlock:
+	rcu_read_unlock();
+out:
+	NAPI_GRO_CB(skb)->flush |= flush;
+
+	return pp;
+}
+
+static int gre_gro_complete(struct sk_buff *skb, int nhoff)
+{
+	struct gre_base_hdr *greh = (struct gre_base_hdr *)(skb->data + nhoff);
+	struct packet_offload *ptype;
+	int grehlen = sizeof(*greh);
+	int err = -ENOENT;
+
+	if (greh->flags & GRE_KEY)
+		grehlen += GRE_HEADER_SECTION;
+
+	/* the inner headers are recorded for GSO on forwarding */
+	skb->encapsulation = 1;
+	skb_set_inner_mac_header(skb, nhoff + grehlen);
+
+	rcu_read_lock();
+	ptype = gro_find_complete_by_type(greh->protocol);
+	if (ptype)
+		err = ptype->callbacks.gro_complete(skb, nhoff + grehlen);
+	rcu_read_unlock();
+
+	if (!err)
+		skb_shinfo(skb)->gso_type |= SKB_GSO_GRE;
+
+	return err;
+}
+
 static const struct net_protocol net_gre_protocol = {
 	.handler     = gre_rcv,
 	.err_handler = gre_err,
@@ -217,6 +330,8 @@ static const struct net_offload gre_offload = {
 	.callbacks = {
 		.gso_send_check =	gre_gso_send_check,
 		.gso_segment    =	gre_gso_segment,
+		.gro_receive    =	gre_gro_receive,
+		.gro_complete   =	gre_gro_complete,
 	},
 };
 
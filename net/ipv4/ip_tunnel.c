@@ -415,6 +415,12 @@ int ip_tunnel_rcv(struct ip_tunnel *tunnel, struct sk_buff *skb,
 	skb->mac_header = skb->network_header;
 	__pskb_pull(skb, hdr_len);
 	skb_postpull_rcsum(skb, skb_transport_header(skb), tunnel->hlen);
+
+	/* Merged by GRO, the GRE layer is gone from here on */
+	if (skb_is_gso(skb)) {
+		skb_shinfo(skb)->gso_type &= ~SKB_GSO_GRE;
+		skb->encapsulation = 0;
+	}
 #ifdef CONFIG_NET_IPGRE_BROADCAST
 	if (ipv4_is_multicast(iph->daddr)) {
 		/* Looped back packet, drop it! */
@@ -0,0 +1,96 @@
+/*
+ * nf_tables IPv4 address family.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/ip.h>
+#include <linux/netfilter_ipv4.h>
+#include <net/ip.h>
+#include <net/net_namespace.h>
+#include <net/netfilter/nf_tables.h>
+
+static struct nft_af_info nft_af_ipv4;
+
+static void nft_set_pktinfo_ipv4(struct nft_pktinfo *pkt,
+				 unsigned int hooknum,
+				 struct sk_buff *skb,
+				 const struct net_device *in,
+				 const struct net_device *out)
+{
+	const struct iphdr *ip;
+
+	nft_set_pktinfo(pkt, hooknum, skb, in, out);
+
+	ip = ip_hdr(skb);
+	pkt->tprot = ip->protocol;
+	pkt->thoff = skb_network_offset(skb) + ip_hdrlen(skb);
+	pkt->fragoff = ntohs(ip->frag_off) & IP_OFFSET;
+}
+
+static unsigned int nft_do_chain_ipv4(unsigned int hooknum,
+				      struct sk_buff *skb,
+				      const struct net_device *in,
+				      const struct net_device *out,
+				      int (*okfn)(struct sk_buff *))
+{
+	struct nft_pktinfo pkt;
+
+	/* rules are only configurable from the initial namespace */
+	if (!net_eq(dev_net(in ? in : out), &init_net))
+		return NF_ACCEPT;
+
+	nft_set_pktinfo_ipv4(&pkt, hooknum, skb, in, out);
+	return nft_do_hook(&pkt, &nft_af_ipv4);
+}
+
+static unsigned int nft_ipv4_output(unsigned int hooknum,
+				    struct sk_buff *skb,
+				    const struct net_device *in,
+				    const struct net_device *out,
+				    int (*okfn)(struct sk_buff *))
+{
+	/* root is playing with raw sockets. */
+	if (unlikely(skb->len < sizeof(struct iphdr) ||
+		     ip_hdr(skb)->ihl * 4 < sizeof(struct iphdr))) {
+		net_notice_ratelimited("nf_tables_ipv4: ignoring short SOCK_RAW packet\n");
+		return NF_ACCEPT;
+	}
+
+	return nft_do_chain_ipv4(hooknum, skb, in, out, okfn);
+}
+
+static struct nft_af_info nft_af_ipv4 __read_mostly = {
+	.family		= NFPROTO_IPV4,
+	.nhooks		= NF_INET_NUMHOOKS,
+	.owner		= THIS_MODULE,
+	.hook_priority	= NF_IP_PRI_FILTER,
+	.hooks		= {
+		[NF_INET_PRE_ROUTING]	= nft_do_chain_ipv4,
+		[NF_INET_LOCAL_IN]	= nft_do_chain_ipv4,
+		[NF_INET_FORWARD]	= nft_do_chain_ipv4,
+		[NF_INET_LOCAL_OUT]	= nft_ipv4_output,
+		[NF_INET_POST_ROUTING]	= nft_do_chain_ipv4,
+	},
+};
+
+static int __init nf_tables_ipv4_init(void)
+{
+	return nft_register_afinfo(&nft_af_ipv4);
+}
+
+static void __exit nf_tables_ipv4_exit(void)
+{
+	nft_unregister_afinfo(&nft_af_ipv4);
+}
+
+module_init(nf_tables_ipv4_init);
+module_exit(nf_tables_ipv4_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("nf_tables IPv4 address family");
+MODULE_ALIAS_NFT_FAMILY(AF_INET);
@@ -109,6 +109,8 @@
 #include <trace/events/udp.h>
 #include <linux/static_key.h>
 #include <trace/events/skb.h>
+#include <net/busy_poll.h>
+#include <net/sock_reuseport.h>
 #include "udp_impl.h"
 
 struct udp_table udp_table __read_mostly;
@@ -193,6 +195,58 @@ static int udp_lib_lport_inuse2(struct net *net, __u16 num,
 	return res;
 }
 
+/*
+ * Join the SO_REUSEPORT group of the sockets already bound to the same
+ * address and port, or start a new one.  Called with hslot->lock held.
+ * Failure only costs the O(1) selection: lookups then fall back to
+ * scoring the hash chain.
+ */
+static void udp_reuseport_add_sock(struct sock *sk, struct udp_hslot *hslot)
+{
+	struct net *net = sock_net(sk);
+	struct hlist_nulls_node *node;
+	kuid_t uid = sock_i_uid(sk);
+	struct sock *sk2;
+
+	sk_nulls_for_each(sk2, node, &hslot->head) {
+		if (net_eq(sock_net(sk2), net) &&
+		    sk2 != sk &&
+		    udp_sk(sk2)->udp_port_hash == udp_sk(sk)->udp_port_hash &&
+		    sk2->sk_bound_dev_if == sk->sk_bound_dev_if &&
+		    sk2->sk_reuseport && uid_eq(uid, sock_i_uid(sk2)) &&
+		    reuseport_saddr_equal(sk, sk2)) {
+			reuseport_add_sock(sk, sk2);
+			return;
+		}
+	}
+	reuseport_alloc(sk);
+}
+
+/*
+ * Secondary hash counterpart of reuseport_add_node_rcu(): keep hslot2
+ * sorted by rank so lookups can pick from a group at its first member.
+ * Called with hslot2->lock held.
+ */
+static void udp_portaddr_add_node_rcu(struct sock *sk,
+				      struct udp_hslot *hslot2)
+{
+	struct hlist_nulls_node *node, *prev = NULL;
+	int rank = reuseport_sock_rank(sk);
+	struct sock *sk2;
+
+	udp_portaddr_for_each_entry(sk2, node, &hslot2->head) {
+		if (reuseport_sock_rank(sk2) <= rank)
+			break;
+		prev = &udp_sk(sk2)->udp_portaddr_node;
+	}
+
+	if (prev)
+		hlist_nulls_add_after_rcu(prev, &udp_sk(sk)->udp_portaddr_node);
+	else
+		hlist_nulls_add_head_rcu(&udp_sk(sk)->udp_portaddr_node,
+					 &hslot2->head);
+}
+
 /**
  *  udp_lib_get_port  -  UDP/-Lite port lookup for IPv4 and IPv6
  *
@@ -287,14 +341,17 @@ found:
 	udp_sk(sk)->udp_port_hash = snum;
 	udp_sk(sk)->udp_portaddr_hash ^= snum;
 	if (sk_unhashed(sk)) {
-		sk_nulls_add_node_rcu(sk, &hslot->head);
+		if (sk->sk_reuseport)
+			udp_reuseport_add_sock(sk, hslot);
+
+		sock_hold(sk);
+		reuseport_add_node_rcu(sk, &hslot->head);
 		hslot->count++;
 		sock_prot_inuse_add(sock_net(sk), sk->sk_prot, 1);
 
 		hslot2 = udp_hashslot2(udptable, udp_sk(sk)->udp_portaddr_hash);
 		spin_lock(&hslot2->lock);
-		hlist_nulls_add_head_rcu(&udp_sk(sk)->udp_portaddr_node,
-					 &hslot2->head);
+		udp_portaddr_add_node_rcu(sk, hslot2);
 		hslot2->count++;
 		spin_unlock(&hslot2->lock);
 	}
@@ -412,7 +469,7 @@ static struct sock *udp4_lib_lookup2(struct net *net,
 		__be32 daddr, unsigned int hnum, int dif,
 		struct udp_hslot *hslot2, unsigned int slot2)
 {
-	struct sock *sk, *result;
+	struct sock *sk, *sk2, *result;
 	struct hlist_nulls_node *node;
 	int score, badness, matches = 0, reuseport = 0;
 	u32 hash = 0;
@@ -430,6 +487,17 @@ begin:
 			if (reuseport) {
 				hash = inet_ehashfn(net, daddr, hnum,
 						    saddr, htons(sport));
+				/* The chain is sorted by rank: unless a
+				 * member is connected, no later socket can
+				 * score higher than the group.
+				 */
+				if (!reuseport_has_conns(sk, false)) {
+					sk2 = reuseport_select_sock(sk, hash);
+					if (sk2) {
+						result = sk2;
+						goto found;
+					}
+				}
 				matches = 1;
 			}
 		} else if (score == badness && reuseport) {
@@ -446,6 +514,7 @@ begin:
 	 */
 	if (get_nulls_value(node) != slot2)
 		goto begin;
+found:
 	if (result) {
 		if (unlikely(!atomic_inc_not_zero_hint(&result->sk_refcnt, 2)))
 			result = NULL;
@@ -465,7 +534,7 @@ struct sock *__udp4_lib_lookup(struct net *net, __be32 saddr,
 		__be16 sport, __be32 daddr, __be16 dport,
 		int dif, struct udp_table *udptable)
 {
-	struct sock *sk, *result;
+	struct sock *sk, *sk2, *result;
 	struct hlist_nulls_node *node;
 	unsigned short hnum = ntohs(dport);
 	unsigned int hash2, slot2, slot = udp_hashfn(net, hnum, udptable->mask);
@@ -511,6 +580,17 @@ begin:
 			if (reuseport) {
 				hash = inet_ehashfn(net, daddr, hnum,
 						    saddr, htons(sport));
+				/* The chain is sorted by rank: unless a
+				 * member is connected, no later socket can
+				 * score higher than the group.
+				 */
+				if (!reuseport_has_conns(sk, false)) {
+					sk2 = reuseport_select_sock(sk, hash);
+					if (sk2) {
+						result = sk2;
+						goto found;
+					}
+				}
 				matches = 1;
 			}
 		} else if (score == badness && reuseport) {
@@ -527,7 +607,7 @@ begin:
 	 */
 	if (get_nulls_value(node) != slot)
 		goto begin;
-
+found:
 	if (result) {
 		if (unlikely(!atomic_inc_not_zero_hint(&result->sk_refcnt, 2)))
 			result = NULL;
@@ -740,7 +820,7 @@ static void udp4_hwcsum(struct sk_buff *skb, __be32 src, __be32 dst)
 	}
 }
 
-static int udp_send_skb(struct sk_buff *skb, struct flowi4 *fl4)
+static int udp_send_skb(struct sk_buff *skb, struct flowi4 *fl4, u16 gso_size)
 {
 	struct sock *sk = skb->sk;
 	struct inet_sock *inet = inet_sk(sk);
@@ -760,6 +840,31 @@ static int udp_send_skb(struct sk_buff *skb, struct flowi4 *fl4)
 	uh->len = htons(len);
 	uh->check = 0;
 
+	if (gso_size && len - sizeof(*uh) > gso_size) {	/* UDP_SEGMENT */
+		const int hlen = skb_network_header_len(skb) + sizeof(*uh);
+		unsigned int mtu = inet->pmtudisc == IP_PMTUDISC_PROBE ?
+				   skb_dst(skb)->dev->mtu :
+				   dst_mtu(skb_dst(skb));
+
+		if (hlen + gso_size > mtu ||
+		    len - sizeof(*uh) > gso_size * UDP_MAX_SEGMENTS ||
+		    sk->sk_no_check == UDP_CSUM_NOXMIT) {
+			kfree_skb(skb);
+			return -EINVAL;
+		}
+		/* segments are checksummed by the device or by GSO */
+		if (skb->ip_summed != CHECKSUM_PARTIAL || is_udplite ||
+		    dst_xfrm(skb_dst(skb))) {
+			kfree_skb(skb);
+			return -EIO;
+		}
+
+		skb_shinfo(skb)->gso_size = gso_size;
+		skb_shinfo(skb)->gso_type = SKB_GSO_UDP_L4;
+		skb_shinfo(skb)->gso_segs = DIV_ROUND_UP(len - sizeof(*uh),
+							 gso_size);
+	}
+
 	if (is_udplite)  				 /*     UDP-Lite      */
 		csum = udplite_csum(skb);
 
@@ -811,7 +916,7 @@ int udp_push_pending_frames(struct sock *sk)
 	if (!skb)
 		goto out;
 
-	err = udp_send_skb(skb, fl4);
+	err = udp_send_skb(skb, fl4, inet->cork.base.gso_size);
 
 out:
 	up->len = 0;
@@ -853,6 +958,7 @@ int udp_sendmsg(struct kiocb *iocb, struct sock *sk, struct msghdr *msg,
 
 	ipc.opt = NULL;
 	ipc.tx_flags = 0;
+	ipc.gso_size = up->gso_size;
 
 	getfrag = is_udplite ? udplite_getfrag : ip_generic_getfrag;
 
@@ -998,7 +1104,7 @@ back_from_confirm:
 				  msg->msg_flags);
 		err = PTR_ERR(skb);
 		if (!IS_ERR_OR_NULL(skb))
-			err = udp_send_skb(skb, fl4);
+			err = udp_send_skb(skb, fl4, ipc.gso_size);
 		goto out;
 	}
 
@@ -1277,6 +1383,8 @@ try_again:
 	}
 	if (inet->cmsg_flags)
 		ip_cmsg_recv(msg, skb);
+	if (udp_sk(sk)->gro_enabled)
+		udp_cmsg_recv(msg, skb);
 
 	err = copied;
 	if (flags & MSG_TRUNC)
@@ -1339,6 +1447,8 @@ void udp_lib_unhash(struct sock *sk)
 		hslot2 = udp_hashslot2(udptable, udp_sk(sk)->udp_portaddr_hash);
 
 		spin_lock_bh(&hslot->lock);
+		if (rcu_access_pointer(sk->sk_reuseport_cb))
+			reuseport_detach_sock(sk);
 		if (sk_nulls_del_node_init_rcu(sk)) {
 			hslot->count--;
 			inet_sk(sk)->inet_num = 0;
@@ -1366,25 +1476,31 @@ void udp_lib_rehash(struct sock *sk, u16 newhash)
 		hslot2 = udp_hashslot2(udptable, udp_sk(sk)->udp_portaddr_hash);
 		nhslot2 = udp_hashslot2(udptable, newhash);
 		udp_sk(sk)->udp_portaddr_hash = newhash;
-		if (hslot2 != nhslot2) {
-			hslot = udp_hashslot(udptable, sock_net(sk),
-					     udp_sk(sk)->udp_port_hash);
-			/* we must lock primary chain too */
-			spin_lock_bh(&hslot->lock);
 
-			spin_lock(&hslot2->lock);
-			hlist_nulls_del_init_rcu(&udp_sk(sk)->udp_portaddr_node);
-			hslot2->count--;
-			spin_unlock(&hslot2->lock);
+		hslot = udp_hashslot(udptable, sock_net(sk),
+				     udp_sk(sk)->udp_port_hash);
+		/* we must lock primary chain too */
+		spin_lock_bh(&hslot->lock);
 
-			spin_lock(&nhslot2->lock);
-			hlist_nulls_add_head_rcu(&udp_sk(sk)->udp_portaddr_node,
-						 &nhslot2->head);
-			nhslot2->count++;
-			spin_unlock(&nhslot2->lock);
+		/* the bound address changed: leave the group */
+		if (rcu_access_pointer(sk->sk_reuseport_cb))
+			reuseport_detach_sock(sk);
 
-			spin_unlock_bh(&hslot->lock);
-		}
+		/* and so did its rank: re-sort it in both chains */
+		hlist_nulls_del_init_rcu(&sk->sk_nulls_node);
+		reuseport_add_node_rcu(sk, &hslot->head);
+
+		spin_lock(&hslot2->lock);
+		hlist_nulls_del_init_rcu(&udp_sk(sk)->udp_portaddr_node);
+		hslot2->count--;
+		spin_unlock(&hslot2->lock);
+
+		spin_lock(&nhslot2->lock);
+		udp_portaddr_add_node_rcu(sk, nhslot2);
+		nhslot2->count++;
+		spin_unlock(&nhslot2->lock);
+
+		spin_unlock_bh(&hslot->lock);
 	}
 }
 EXPORT_SYMBOL(udp_lib_rehash);
@@ -1401,8 +1517,10 @@ static int __udp_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
 {
 	int rc;
 
-	if (inet_sk(sk)->inet_daddr)
+	if (inet_sk(sk)->inet_daddr) {
 		sock_rps_save_rxhash(sk, skb);
+		sk_mark_napi_id(sk, skb);
+	}
 
 	rc = sock_queue_rcv_skb(sk, skb);
 	if (rc < 0) {
@@ -1430,15 +1548,15 @@ void udp_encap_enable(void)
 }
 EXPORT_SYMBOL(udp_encap_enable);
 
-/* returns:
- *  -1: error
- *   0: success
- *  >0: "udp encap" protocol resubmission
- *
- * Note that in the success and error cases, the skb is assumed to
- * have either been requeued or freed.
- */
-int udp_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
+/* Only look for UDP_GRO sockets in the GRO path once one was created. */
+static struct static_key udp_gro_needed __read_mostly;
+static void udp_gro_enable(void)
+{
+	if (!static_key_enabled(&udp_gro_needed))
+		static_key_slow_inc(&udp_gro_needed);
+}
+
+static int udp_queue_rcv_one_skb(struct sock *sk, struct sk_buff *skb)
 {
 	struct udp_sock *up = udp_sk(sk);
 	int rc;
@@ -1547,6 +1665,64 @@ drop:
 	return -1;
 }
 
+/* Split a coalesced skb back into its datagrams, for a socket that did not
+ * set UDP_GRO.  Returns the list of datagrams, with data at the UDP header.
+ */
+static struct sk_buff *udp_rcv_segment(struct sock *sk, struct sk_buff *skb)
+{
+	struct udp_skb_cb cb = *UDP_SKB_CB(skb);
+	struct sk_buff *segs, *seg;
+
+	/* GSO walks the headers from the mac header and uses the cb */
+	if (skb_unclone(skb, GFP_ATOMIC))
+		goto drop;
+	__skb_push(skb, skb->data - skb_mac_header(skb));
+	segs = __skb_gso_segment(skb, NETIF_F_SG | NETIF_F_IP_CSUM, false);
+	if (IS_ERR_OR_NULL(segs))
+		goto drop;
+	consume_skb(skb);
+
+	for (seg = segs; seg; seg = seg->next) {
+		__skb_pull(seg, skb_transport_offset(seg));
+		*UDP_SKB_CB(seg) = cb;
+		seg->ip_summed = CHECKSUM_UNNECESSARY;
+	}
+	return segs;
+
+drop:
+	UDP_INC_STATS_BH(sock_net(sk), UDP_MIB_INERRORS, IS_UDPLITE(sk));
+	atomic_inc(&sk->sk_drops);
+	kfree_skb(skb);
+	return NULL;
+}
+
+/* returns:
+ *  -1: error
+ *   0: success
+ *  >0: "udp encap" protocol resubmission
+ *
+ * Note that in the success and error cases, the skb is assumed to
+ * have either been requeued or freed.
+ */
+int udp_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
+{
+	struct sk_buff *next, *segs;
+
+	if (likely(!(skb_shinfo(skb)->gso_type & SKB_GSO_UDP_L4) ||
+		   udp_sk(sk)->gro_enabled))
+		return udp_queue_rcv_one_skb(sk, skb);
+
+	segs = udp_rcv_segment(sk, skb);
+	for (skb = segs; skb; skb = next) {
+		next = skb->next;
+		skb->next = NULL;
+		/* a split datagram cannot be resubmitted to another protocol */
+		if (udp_queue_rcv_one_skb(sk, skb) > 0)
+			kfree_skb(skb);
+	}
+	return 0;
+}
+
 
 static void flush_stack(struct sock **stack, unsigned int count,
 			struct sk_buff *skb, unsigned int final)
@@ -1649,7 +1825,9 @@ static inline int udp4_csum_init(struct sk_buff *skb, struct udphdr *uh,
 
 	iph = ip_hdr(skb);
 	if (uh->check == 0) {
-		skb->ip_summed = CHECKSUM_UNNECESSARY;
+		/* a tunnel packet merged by GRO stays CHECKSUM_PARTIAL */
+		if (skb->ip_summed != CHECKSUM_PARTIAL)
+			skb->ip_summed = CHECKSUM_UNNECESSARY;
 	} else if (skb->ip_summed == CHECKSUM_COMPLETE) {
 		if (!csum_tcpudp_magic(iph->saddr, iph->daddr, skb->len,
 				      proto, skb->csum))
@@ -1829,6 +2007,22 @@ int udp_lib_setsockopt(struct sock *sk, int level, int optname,
 		}
 		break;
 
+	case UDP_SEGMENT:
+		if (sk->sk_family != AF_INET || is_udplite)
+			return -ENOPROTOOPT;
+		if (val < 0 || val > USHRT_MAX)
+			return -EINVAL;
+		up->gso_size = val;
+		break;
+
+	case UDP_GRO:
+		if (sk->sk_family != AF_INET || is_udplite)
+			return -ENOPROTOOPT;
+		if (val)
+			udp_gro_enable();
+		up->gro_enabled = !!val;
+		break;
+
 	/*
 	 * 	UDP-Lite's partial checksum coverage (RFC 3828).
 	 */
@@ -1911,6 +2105,14 @@ int udp_lib_getsockopt(struct sock *sk, int level, int optname,
 		val = up->encap_type;
 		break;
 
+	case UDP_SEGMENT:
+		val = up->gso_size;
+		break;
+
+	case UDP_GRO:
+		val = up->gro_enabled;
+		break;
+
 	/* The following two cannot be changed on UDP sockets, the return is
 	 * always 0 (which corresponds to the full checksum coverage of UDP). */
 	case UDPLITE_SEND_CSCOV:
@@ -2367,11 +2569,63 @@ out:
 	return segs;
 }
 
+/* Split a UDP_SEGMENT skb into datagrams of gso_size bytes of payload, each
+ * with a copy of the UDP header.  IP headers are updated in
+ * inet_gso_segment().
+ */
+static struct sk_buff *udp4_gso_segment(struct sk_buff *gso_skb,
+					netdev_features_t features)
+{
+	unsigned int mss = skb_shinfo(gso_skb)->gso_size;
+	struct sk_buff *segs, *seg;
+	struct udphdr *uh;
+
+	if (gso_skb->len <= sizeof(*uh) + mss)
+		return ERR_PTR(-EINVAL);
+
+	if (!pskb_may_pull(gso_skb, sizeof(*uh)))
+		return ERR_PTR(-EINVAL);
+
+	__skb_pull(gso_skb, sizeof(*uh));
+
+	segs = skb_segment(gso_skb, features);
+	if (IS_ERR_OR_NULL(segs))
+		return segs;
+
+	for (seg = segs; seg; seg = seg->next) {
+		const struct iphdr *iph = ip_hdr(seg);
+		unsigned int len = seg->len - skb_transport_offset(seg);
+
+		uh = udp_hdr(seg);
+		uh->len = htons(len);
+		uh->check = 0;
+
+		if (seg->ip_summed == CHECKSUM_PARTIAL) {
+			uh->check = ~csum_tcpudp_magic(iph->saddr, iph->daddr,
+						       len, IPPROTO_UDP, 0);
+		} else {
+			/* seg->csum covers the payload only */
+			uh->check = csum_tcpudp_magic(iph->saddr, iph->daddr,
+						      len, IPPROTO_UDP,
+						      csum_partial(uh, sizeof(*uh),
+								   seg->csum));
+			if (uh->check == 0)
+				uh->check = CSUM_MANGLED_0;
+		}
+	}
+
+	return segs;
+}
+
 struct sk_buff *udp4_ufo_fragment(struct sk_buff *skb,
 	netdev_features_t features)
 {
 	struct sk_buff *segs = ERR_PTR(-EINVAL);
 	unsigned int mss;
+
+	if (skb_shinfo(skb)->gso_type & SKB_GSO_UDP_L4)
+		return udp4_gso_segment(skb, features);
+
 	mss = skb_shinfo(skb)->gso_size;
 	if (unlikely(skb->len <= mss))
 		goto out;
@@ -2416,3 +2670,269 @@ struct sk_buff *udp4_ufo_fragment(struct sk_buff *skb,
 out:
 	return segs;
 }
+
+static LIST_HEAD(udp_offload_list);
+static DEFINE_SPINLOCK(udp_offload_lock);
+
+/**
+ *	udp_add_offload - register the GRO handlers of a UDP encapsulation
+ *	@uo: offload declaration, with the destination port in network order
+ *
+ *	Datagrams to @uo->port are handed to @uo->callbacks.gro_receive with
+ *	the UDP header pulled, so that the encapsulated packets are merged.
+ */
+void udp_add_offload(struct udp_offload *uo)
+{
+	spin_lock(&udp_offload_lock);
+	list_add_rcu(&uo->list, &udp_offload_list);
+	spin_unlock(&udp_offload_lock);
+}
+EXPORT_SYMBOL(udp_add_offload);
+
+/**
+ *	udp_del_offload - unregister the GRO handlers of a UDP encapsulation
+ *	@uo: offload declaration passed to udp_add_offload()
+ *
+ *	This call sleeps until no CPU can be using @uo any more.
+ */
+void udp_del_offload(struct udp_offload *uo)
+{
+	spin_lock(&udp_offload_lock);
+	list_del_rcu(&uo->list);
+	spin_unlock(&udp_offload_lock);
+
+	synchronize_net();
+}
+EXPORT_SYMBOL(udp_del_offload);
+
+/* Called under rcu_read_lock() */
+static struct udp_offload *udp_offload_find(__be16 port)
+{
+	struct udp_offload *uo;
+
+	list_for_each_entry_rcu(uo, &udp_offload_list, list) {
+		if (uo->port == port)
+			return uo;
+	}
+	return NULL;
+}
+
+/*
+ * Verify the UDP checksum of a datagram seen by GRO. skb->ip_summed is
+ * left alone, so that an encapsulated packet still has its own checksum
+ * verified by the inner protocol.
+ */
+static bool udp4_gro_checksum_ok(struct sk_buff *skb, const struct iphdr *iph)
+{
+	__wsum wsum;
+
+	switch (skb->ip_summed) {
+	case CHECKSUM_COMPLETE:
+		if (csum_tcpudp_magic(iph->saddr, iph->daddr, skb_gro_len(skb),
+				      IPPROTO_UDP, skb->csum))
+			return false;
+		break;
+
+	case CHECKSUM_NONE:
+		wsum = csum_tcpudp_nofold(iph->saddr, iph->daddr,
+					  skb_gro_len(skb), IPPROTO_UDP, 0);
+		if (csum_fold(skb_checksum(skb, skb_gro_offset(skb),
+					   skb_gro_len(skb), wsum)))
+			return false;
+		break;
+	}
+
+	return true;
+}
+
+/*
+ * Tunnel datagrams are matched on their ports and handed over to the
+ * encapsulation, which merges the inner packets. Inner checksums are
+ * checked by the inner protocols unless the NIC vouched for them, so a
+ * CHECKSUM_UNNECESSARY packet is only merged when it is flagged as
+ * encapsulated, meaning the NIC validated the inner packet too.
+ */
+static struct sk_buff **udp4_tunnel_gro_receive(struct sk_buff **head,
+						struct sk_buff *skb,
+						struct udphdr *uh,
+						const struct udp_offload *uo)
+{
+	const struct iphdr *iph = skb_gro_network_header(skb);
+	unsigned int off = skb_gro_offset(skb);
+	struct sk_buff **pp = NULL;
+	struct sk_buff *p;
+	__wsum csum;
+
+	if (NAPI_GRO_CB(skb)->encap_mark ||
+	    ntohs(uh->len) != skb_gro_len(skb))
+		goto flush;
+
+	if (skb->ip_summed == CHECKSUM_UNNECESSARY) {
+		if (!skb->encapsulation)
+			goto flush;
+	} else if (uh->check && !udp4_gro_checksum_ok(skb, iph)) {
+		goto flush;
+	}
+
+	NAPI_GRO_CB(skb)->encap_mark = 1;
+
+	for (p = *head; p; p = p->next) {
+		const struct udphdr *uh2;
+
+		if (!NAPI_GRO_CB(p)->same_flow)
+			continue;
+
+		uh2 = (struct udphdr *)(p->data + off);
+		if (*(u32 *)&uh->source != *(u32 *)&uh2->source ||
+		    !uh->check != !uh2->check) {
+			NAPI_GRO_CB(p)->same_flow = 0;
+			continue;
+		}
+	}
+
+	skb_gro_pull(skb, sizeof(*uh));
+
+	csum = skb->csum;
+	skb_postpull_rcsum(skb, uh, sizeof(*uh));
+
+	pp = uo->callbacks.gro_receive(head, skb);
+
+	skb->csum = csum;
+
+	return pp;
+
+flush:
+	NAPI_GRO_CB(skb)->flush = 1;
+	return NULL;
+}
+
+/**
+ *	udp4_gro_receive - coalesce the datagrams of a flow
+ *	@head: list of skbs held by GRO
+ *	@skb: new datagram
+ *
+ *	Datagrams to a port registered with udp_add_offload() are merged by
+ *	their encapsulation. Otherwise this is only done for a local socket
+ *	that set UDP_GRO, which gets one skb made of datagrams of equal
+ *	size, the last one possibly shorter, and the size of these datagrams
+ *	in a UDP_GRO cmsg.
+ */
+struct sk_buff **udp4_gro_receive(struct sk_buff **head, struct sk_buff *skb)
+{
+	const struct iphdr *iph = skb_gro_network_header(skb);
+	const struct udp_offload *uo;
+	struct sk_buff **pp = NULL;
+	struct udphdr *uh, *uh2;
+	unsigned int hlen, off;
+	unsigned int len, mss;
+	struct sk_buff *p;
+	struct sock *sk;
+	bool gro;
+
+	if (list_empty(&udp_offload_list) &&
+	    !static_key_false(&udp_gro_needed))
+		goto flush;
+
+	off = skb_gro_offset(skb);
+	hlen = off + sizeof(*uh);
+	uh = skb_gro_header_fast(skb, off);
+	if (skb_gro_header_hard(skb, hlen)) {
+		uh = skb_gro_header_slow(skb, hlen, off);
+		if (unlikely(!uh))
+			goto flush;
+	}
+
+	/* inet_gro_receive() holds rcu_read_lock() */
+	uo = udp_offload_find(uh->dest);
+	if (uo)
+		return udp4_tunnel_gro_receive(head, skb, uh, uo);
+
+	if (!static_key_false(&udp_gro_needed))
+		goto flush;
+
+	/* requires a checksum, for symmetry with UDP_SEGMENT */
+	if (!uh->check || ntohs(uh->len) != skb_gro_len(skb))
+		goto flush;
+
+	sk = __udp4_lib_lookup(dev_net(skb->dev), iph->saddr, uh->source,
+			       iph->daddr, uh->dest, skb->dev->ifindex,
+			       &udp_table);
+	gro = sk && udp_sk(sk)->gro_enabled;
+	if (sk)
+		sock_put(sk);
+	if (!gro)
+		goto flush;
+
+	if (!udp4_gro_checksum_ok(skb, iph))
+		goto flush;
+	skb->ip_summed = CHECKSUM_UNNECESSARY;
+
+	skb_gro_pull(skb, sizeof(*uh));
+	len = skb_gro_len(skb);
+
+	for (; (p = *head); head = &p->next) {
+		if (!NAPI_GRO_CB(p)->same_flow)
+			continue;
+
+		uh2 = (struct udphdr *)(p->data + off);
+
+		/* Match ports only, as csum is always non zero */
+		if (*(u32 *)&uh->source != *(u32 *)&uh2->source) {
+			NAPI_GRO_CB(p)->same_flow = 0;
+			continue;
+		}
+
+		/* A larger datagram starts a new skb, a shorter one is the
+		 * last of this one; bound the count to limit truesize.
+		 */
+		mss = skb_shinfo(p)->gso_size;
+		if (NAPI_GRO_CB(p)->flush || len > mss ||
+		    skb_gro_receive(head, skb) || len < mss ||
+		    NAPI_GRO_CB(*head)->count >= UDP_MAX_SEGMENTS)
+			pp = head;
+		break;
+	}
+
+	return pp;
+
+flush:
+	NAPI_GRO_CB(skb)->flush = 1;
+	return NULL;
+}
+
+int udp4_gro_complete(struct sk_buff *skb, int nhoff)
+{
+	struct udphdr *uh = (struct udphdr *)(skb->data + nhoff);
+	const struct udp_offload *uo;
+	int err = 0;
+
+	uh->len = htons(skb->len - nhoff);
+
+	rcu_read_lock();
+	uo = udp_offload_find(uh->dest);
+	if (uo) {
+		/* the inner headers are recorded for GSO on forwarding */
+		skb->encapsulation = 1;
+		err = uo->callbacks.gro_complete(skb, nhoff + sizeof(*uh));
+		if (!err)
+			skb_shinfo(skb)->gso_type |= SKB_GSO_UDP_TUNNEL;
+	}
+	rcu_read_unlock();
+
+	if (uo)
+		return err;
+
+	/* As tcp_gro_complete() does, leave the checksums to be filled in
+	 * for each datagram, should the skb be forwarded and segmented.
+	 */
+	uh->check = ~csum_tcpudp_magic(ip_hdr(skb)->saddr, ip_hdr(skb)->daddr,
+				       skb->len - nhoff, IPPROTO_UDP, 0);
+	skb->csum_start = (unsigned char *)uh - skb->head;
+	skb->csum_offset = offsetof(struct udphdr, check);
+	skb->ip_summed = CHECKSUM_PARTIAL;
+
+	skb_shinfo(skb)->gso_type = SKB_GSO_UDP_L4;
+	skb_shinfo(skb)->gso_segs = NAPI_GRO_CB(skb)->count;
+
+	return 0;
+}
@@ -31,6 +31,7 @@
 #include <net/ip6_route.h>
 #include <net/tcp_states.h>
 #include <net/dsfield.h>
+#include <net/sock_reuseport.h>
 
 #include <linux/errqueue.h>
 #include <asm/uaccess.h>
@@ -145,6 +146,7 @@ ipv4_connected:
 		}
 	}
 
+	reuseport_has_conns(sk, true);
 	np->daddr = *daddr;
 	np->flow_label = fl6.flowlabel;
 
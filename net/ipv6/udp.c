@@ -50,6 +50,8 @@
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
 #include <trace/events/skb.h>
+#include <net/busy_poll.h>
+#include <net/sock_reuseport.h>
 #include "udp_impl.h"
 
 int ipv6_rcv_saddr_equal(const struct sock *sk, const struct sock *sk2)
@@ -202,7 +204,7 @@ static struct sock *udp6_lib_lookup2(struct net *net,
 		const struct in6_addr *daddr, unsigned int hnum, int dif,
 		struct udp_hslot *hslot2, unsigned int slot2)
 {
-	struct sock *sk, *result;
+	struct sock *sk, *sk2, *result;
 	struct hlist_nulls_node *node;
 	int score, badness, matches = 0, reuseport = 0;
 	u32 hash = 0;
@@ -220,6 +222,17 @@ begin:
 			if (reuseport) {
 				hash = inet6_ehashfn(net, daddr, hnum,
 						     saddr, sport);
+				/* The chain is sorted by rank: unless a
+				 * member is connected, no later socket can
+				 * score higher than the group.
+				 */
+				if (!reuseport_has_conns(sk, false)) {
+					sk2 = reuseport_select_sock(sk, hash);
+					if (sk2) {
+						result = sk2;
+						goto exact_match;
+					}
+				}
 				matches = 1;
 			} else if (score == SCORE2_MAX)
 				goto exact_match;
@@ -256,7 +269,7 @@ struct sock *__udp6_lib_lookup(struct net *net,
 				      const struct in6_addr *daddr, __be16 dport,
 				      int dif, struct udp_table *udptable)
 {
-	struct sock *sk, *result;
+	struct sock *sk, *sk2, *result;
 	struct hlist_nulls_node *node;
 	unsigned short hnum = ntohs(dport);
 	unsigned int hash2, slot2, slot = udp_hashfn(net, hnum, udptable->mask);
@@ -301,6 +314,17 @@ begin:
 			if (reuseport) {
 				hash = inet6_ehashfn(net, daddr, hnum,
 						     saddr, sport);
+				/* The chain is sorted by rank: unless a
+				 * member is connected, no later socket can
+				 * score higher than the group.
+				 */
+				if (!reuseport_has_conns(sk, false)) {
+					sk2 = reuseport_select_sock(sk, hash);
+					if (sk2) {
+						result = sk2;
+						goto found;
+					}
+				}
 				matches = 1;
 			}
 		} else if (score == badness && reuseport) {
@@ -317,7 +341,7 @@ begin:
 	 */
 	if (get_nulls_value(node) != slot)
 		goto begin;
-
+found:
 	if (result) {
 		if (unlikely(!atomic_inc_not_zero_hint(&result->sk_refcnt, 2)))
 			result = NULL;
@@ -548,8 +572,10 @@ static int __udpv6_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
 {
 	int rc;
 
-	if (!ipv6_addr_any(&inet6_sk(sk)->daddr))
+	if (!ipv6_addr_any(&inet6_sk(sk)->daddr)) {
 		sock_rps_save_rxhash(sk, skb);
+		sk_mark_napi_id(sk, skb);
+	}
 
 	rc = sock_queue_rcv_skb(sk, skb);
 	if (rc < 0) {
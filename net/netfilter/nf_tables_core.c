@@ -0,0 +1,175 @@
+/*
+ * nf_tables rule evaluation.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/list.h>
+#include <linux/rculist.h>
+#include <linux/skbuff.h>
+#include <linux/netlink.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nfnetlink.h>
+#include <linux/netfilter/nf_tables.h>
+#include <net/netfilter/nf_tables_core.h>
+#include <net/netfilter/nf_tables.h>
+
+struct nft_jumpstack {
+	const struct nft_chain	*chain;
+	const struct nft_rule	*rule;
+};
+
+/**
+ *	nft_do_chain - evaluate a base chain and the chains it jumps to
+ *
+ *	@pkt: packet information
+ *	@basechain: the base chain to start evaluation at
+ *
+ *	Must be called with rcu_read_lock held. Rules are evaluated in order,
+ *	each rule being a sequence of expressions operating on the registers.
+ *	An expression that does not match sets the verdict register to
+ *	NFT_BREAK, which ends evaluation of the rule. Jumps push the current
+ *	position on a fixed size stack; the depth is bounded when the rules are
+ *	loaded, see nft_validate_data_load().
+ */
+unsigned int nft_do_chain(const struct nft_pktinfo *pkt,
+			  const struct nft_chain *basechain)
+{
+	const struct nft_chain *chain = basechain;
+	const struct nft_rule *rule;
+	const struct nft_expr *expr, *last;
+	struct nft_data data[NFT_REG_MAX + 1];
+	unsigned int stackptr = 0;
+	struct nft_jumpstack jumpstack[NFT_JUMP_STACK_SIZE];
+
+do_chain:
+	rule = list_entry(&chain->rules, struct nft_rule, list);
+next_rule:
+	data[NFT_REG_VERDICT].verdict = NFT_CONTINUE;
+	list_for_each_entry_continue_rcu(rule, &chain->rules, list) {
+		nft_rule_for_each_expr(expr, last, rule) {
+			expr->ops->eval(expr, data, pkt);
+
+			if (data[NFT_REG_VERDICT].verdict != NFT_CONTINUE)
+				break;
+		}
+
+		switch (data[NFT_REG_VERDICT].verdict) {
+		case NFT_BREAK:
+			data[NFT_REG_VERDICT].verdict = NFT_CONTINUE;
+			/* fall through */
+		case NFT_CONTINUE:
+			continue;
+		}
+		break;
+	}
+
+	switch (data[NFT_REG_VERDICT].verdict) {
+	case NFT_JUMP:
+		if (WARN_ON_ONCE(stackptr >= NFT_JUMP_STACK_SIZE))
+			return NF_DROP;
+		jumpstack[stackptr].chain = chain;
+		jumpstack[stackptr].rule  = rule;
+		stackptr++;
+		/* fall through */
+	case NFT_GOTO:
+		chain = data[NFT_REG_VERDICT].chain;
+		goto do_chain;
+	case NFT_RETURN:
+	case NFT_CONTINUE:
+		break;
+	default:
+		/* NF_ACCEPT, NF_DROP or NF_QUEUE, possibly with a queue number */
+		return data[NFT_REG_VERDICT].verdict;
+	}
+
+	if (stackptr > 0) {
+		stackptr--;
+		chain = jumpstack[stackptr].chain;
+		rule  = jumpstack[stackptr].rule;
+		goto next_rule;
+	}
+
+	return nft_base_chain(basechain)->policy;
+}
+EXPORT_SYMBOL_GPL(nft_do_chain);
+
+/**
+ *	nft_do_hook - evaluate the base chains attached to a hook
+ *
+ *	@pkt: packet information
+ *	@afi: address family the hook belongs to
+ *
+ *	Base chains are evaluated in priority order, an accept verdict passes
+ *	the packet on to the next base chain just like between two netfilter
+ *	hooks.
+ */
+unsigned int nft_do_hook(const struct nft_pktinfo *pkt,
+			 const struct nft_af_info *afi)
+{
+	const struct nft_base_chain *basechain;
+	unsigned int verdict = NF_ACCEPT;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(basechain, &afi->hook_list[pkt->hooknum],
+				hook_list) {
+		verdict = nft_do_chain(pkt, &basechain->chain);
+		if (verdict != NF_ACCEPT)
+			break;
+	}
+	rcu_read_unlock();
+
+	return verdict;
+}
+EXPORT_SYMBOL_GPL(nft_do_hook);
+
+int __init nf_tables_core_module_init(void)
+{
+	int err;
+
+	err = nft_immediate_module_init();
+	if (err < 0)
+		goto err1;
+
+	err = nft_cmp_module_init();
+	if (err < 0)
+		goto err2;
+
+	err = nft_lookup_module_init();
+	if (err < 0)
+		goto err3;
+
+	err = nft_bitwise_module_init();
+	if (err < 0)
+		goto err4;
+
+	err = nft_payload_module_init();
+	if (err < 0)
+		goto err5;
+
+	return 0;
+
+err5:
+	nft_bitwise_module_exit();
+err4:
+	nft_lookup_module_exit();
+err3:
+	nft_cmp_module_exit();
+err2:
+	nft_immediate_module_exit();
+err1:
+	return err;
+}
+
+void nf_tables_core_module_exit(void)
+{
+	nft_payload_module_exit();
+	nft_bitwise_module_exit();
+	nft_lookup_module_exit();
+	nft_cmp_module_exit();
+	nft_immediate_module_exit();
+}
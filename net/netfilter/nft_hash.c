@@ -0,0 +1,264 @@
+/*
+ * nf_tables hash set: keys and map data kept in a fixed size hash table.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/list.h>
+#include <linux/jhash.h>
+#include <linux/log2.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/netlink.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter/nf_tables.h>
+#include <net/netfilter/nf_tables.h>
+
+/* number of buckets used when no size hint was given */
+#define NFT_HASH_DEFAULT_SIZE	1024
+#define NFT_HASH_MIN_SIZE	16
+#define NFT_HASH_MAX_SIZE	(1U << 20)
+
+struct nft_hash {
+	struct hlist_head	*hash;
+	unsigned int		hsize;
+};
+
+struct nft_hash_elem {
+	struct hlist_node	hnode;
+	struct rcu_head		rcu;
+	struct nft_data		key;
+	struct nft_data		data[];
+};
+
+static u32 nft_hash_rnd __read_mostly;
+
+static unsigned int nft_hash_data(const struct nft_data *data,
+				  unsigned int hsize, unsigned int len)
+{
+	unsigned int h;
+
+	h = jhash(data->data, len, nft_hash_rnd);
+	return h & (hsize - 1);
+}
+
+static bool nft_hash_lookup(const struct nft_set *set,
+			    const struct nft_data *key,
+			    struct nft_data *data)
+{
+	const struct nft_hash *priv = nft_set_priv(set);
+	const struct nft_hash_elem *he;
+	unsigned int h;
+
+	h = nft_hash_data(key, priv->hsize, set->klen);
+	hlist_for_each_entry_rcu(he, &priv->hash[h], hnode) {
+		if (nft_data_cmp(&he->key, key, set->klen))
+			continue;
+		if (set->flags & NFT_SET_MAP)
+			nft_data_copy(data, he->data);
+		return true;
+	}
+	return false;
+}
+
+static struct nft_hash_elem *nft_hash_find(const struct nft_set *set,
+					   const struct nft_data *key)
+{
+	const struct nft_hash *priv = nft_set_priv(set);
+	struct nft_hash_elem *he;
+	unsigned int h;
+
+	h = nft_hash_data(key, priv->hsize, set->klen);
+	hlist_for_each_entry(he, &priv->hash[h], hnode) {
+		if (!nft_data_cmp(&he->key, key, set->klen))
+			return he;
+	}
+	return NULL;
+}
+
+static void nft_hash_elem_destroy(const struct nft_set *set,
+				  struct nft_hash_elem *he)
+{
+	nft_data_uninit(&he->key, NFT_DATA_VALUE);
+	if (set->flags & NFT_SET_MAP)
+		nft_data_uninit(he->data, set->dtype);
+	kfree(he);
+}
+
+static int nft_hash_insert(const struct nft_set *set,
+			   const struct nft_set_elem *elem)
+{
+	struct nft_hash *priv = nft_set_priv(set);
+	struct nft_hash_elem *he;
+	unsigned int size, h;
+
+	if (elem->flags != 0)
+		return -EINVAL;
+
+	size = sizeof(*he);
+	if (set->flags & NFT_SET_MAP)
+		size += sizeof(he->data[0]);
+
+	he = kzalloc(size, GFP_KERNEL);
+	if (he == NULL)
+		return -ENOMEM;
+
+	nft_data_copy(&he->key, &elem->key);
+	if (set->flags & NFT_SET_MAP)
+		nft_data_copy(he->data, &elem->data);
+
+	h = nft_hash_data(&he->key, priv->hsize, set->klen);
+	hlist_add_head_rcu(&he->hnode, &priv->hash[h]);
+	return 0;
+}
+
+static void nft_hash_remove(const struct nft_set *set,
+			    const struct nft_set_elem *elem)
+{
+	struct nft_hash_elem *he;
+
+	he = nft_hash_find(set, &elem->key);
+	if (he == NULL)
+		return;
+
+	hlist_del_rcu(&he->hnode);
+	kfree_rcu(he, rcu);
+}
+
+static int nft_hash_get(const struct nft_set *set, struct nft_set_elem *elem)
+{
+	const struct nft_hash_elem *he;
+
+	he = nft_hash_find(set, &elem->key);
+	if (he == NULL)
+		return -ENOENT;
+
+	if (set->flags & NFT_SET_MAP)
+		nft_data_copy(&elem->data, he->data);
+	elem->flags = 0;
+	return 0;
+}
+
+static void nft_hash_walk(const struct nft_ctx *ctx, const struct nft_set *set,
+			  struct nft_set_iter *iter)
+{
+	const struct nft_hash *priv = nft_set_priv(set);
+	const struct nft_hash_elem *he;
+	struct nft_set_elem elem;
+	unsigned int i;
+
+	for (i = 0; i < priv->hsize; i++) {
+		hlist_for_each_entry_rcu(he, &priv->hash[i], hnode) {
+			if (iter->count < iter->skip)
+				goto cont;
+
+			memcpy(&elem.key, &he->key, sizeof(elem.key));
+			if (set->flags & NFT_SET_MAP)
+				memcpy(&elem.data, he->data, sizeof(elem.data));
+			elem.flags = 0;
+
+			iter->err = iter->fn(ctx, set, iter, &elem);
+			if (iter->err < 0)
+				return;
+cont:
+			iter->count++;
+		}
+	}
+}
+
+static unsigned int nft_hash_privsize(const struct nlattr * const nla[])
+{
+	return sizeof(struct nft_hash);
+}
+
+static struct hlist_head *nft_hash_alloc(unsigned int cnt)
+{
+	struct hlist_head *hash;
+	size_t size = cnt * sizeof(struct hlist_head);
+
+	hash = kzalloc(size, GFP_KERNEL | __GFP_NOWARN);
+	if (hash == NULL)
+		hash = vzalloc(size);
+	return hash;
+}
+
+static void nft_hash_free(struct hlist_head *hash)
+{
+	if (is_vmalloc_addr(hash))
+		vfree(hash);
+	else
+		kfree(hash);
+}
+
+static int nft_hash_init(const struct nft_set *set,
+			 const struct nlattr * const nla[])
+{
+	struct nft_hash *priv = nft_set_priv(set);
+	u64 cnt;
+
+	/* keep the load factor at or below 3/4 of the expected size */
+	cnt = NFT_HASH_DEFAULT_SIZE;
+	if (set->size != 0)
+		cnt = roundup_pow_of_two(div_u64((u64)set->size * 4, 3));
+
+	cnt = clamp_t(u64, cnt, NFT_HASH_MIN_SIZE, NFT_HASH_MAX_SIZE);
+
+	priv->hash = nft_hash_alloc(cnt);
+	if (priv->hash == NULL)
+		return -ENOMEM;
+	priv->hsize = cnt;
+	return 0;
+}
+
+static void nft_hash_destroy(const struct nft_set *set)
+{
+	const struct nft_hash *priv = nft_set_priv(set);
+	struct hlist_node *next;
+	struct nft_hash_elem *he;
+	unsigned int i;
+
+	for (i = 0; i < priv->hsize; i++) {
+		hlist_for_each_entry_safe(he, next, &priv->hash[i], hnode) {
+			hlist_del(&he->hnode);
+			nft_hash_elem_destroy(set, he);
+		}
+	}
+	nft_hash_free(priv->hash);
+}
+
+static struct nft_set_ops nft_hash_ops __read_mostly = {
+	.privsize	= nft_hash_privsize,
+	.init		= nft_hash_init,
+	.destroy	= nft_hash_destroy,
+	.get		= nft_hash_get,
+	.insert		= nft_hash_insert,
+	.remove		= nft_hash_remove,
+	.lookup		= nft_hash_lookup,
+	.walk		= nft_hash_walk,
+	.features	= NFT_SET_MAP,
+	.owner		= THIS_MODULE,
+};
+
+static int __init nft_hash_module_init(void)
+{
+	get_random_bytes(&nft_hash_rnd, sizeof(nft_hash_rnd));
+	return nft_register_set(&nft_hash_ops);
+}
+
+static void __exit nft_hash_module_exit(void)
+{
+	nft_unregister_set(&nft_hash_ops);
+}
+
+module_init(nft_hash_module_init);
+module_exit(nft_hash_module_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("nf_tables hash set");
+MODULE_ALIAS_NFT_SET();
@@ -88,6 +88,8 @@
 #include <linux/virtio_net.h>
 #include <linux/errqueue.h>
 #include <linux/net_tstamp.h>
+#include <linux/random.h>
+#include <linux/filter.h>
 
 #ifdef CONFIG_INET
 #include <net/inet_common.h>
@@ -1158,6 +1160,42 @@ static unsigned int fanout_demux_cpu(struct packet_fanout *f,
 	return smp_processor_id() % num;
 }
 
+static unsigned int fanout_demux_rnd(struct packet_fanout *f,
+				     struct sk_buff *skb,
+				     unsigned int num)
+{
+	return (((u64)prandom_u32()) * num) >> 32;
+}
+
+/* Keeps the NIC's RSS spreading; falls back to hashing if not recorded */
+static unsigned int fanout_demux_qm(struct packet_fanout *f,
+				    struct sk_buff *skb,
+				    unsigned int num)
+{
+	if (likely(skb_rx_queue_recorded(skb)))
+		return skb_get_rx_queue(skb) % num;
+
+	skb_get_rxhash(skb);
+	return fanout_demux_hash(f, skb, num);
+}
+
+/* The program returns a member index; data starts at the network header */
+static unsigned int fanout_demux_bpf(struct packet_fanout *f,
+				     struct sk_buff *skb,
+				     unsigned int num)
+{
+	struct sk_filter *prog;
+	unsigned int ret = 0;
+
+	rcu_read_lock();
+	prog = rcu_dereference(f->bpf_prog);
+	if (prog)
+		ret = SK_RUN_FILTER(prog, skb) % num;
+	rcu_read_unlock();
+
+	return ret;
+}
+
 static unsigned int fanout_demux_rollover(struct packet_fanout *f,
 					  struct sk_buff *skb,
 					  unsigned int idx, unsigned int skip,
@@ -1218,13 +1256,26 @@ static int packet_rcv_fanout(struct sk_buff *skb, struct net_device *dev,
 	case PACKET_FANOUT_ROLLOVER:
 		idx = fanout_demux_rollover(f, skb, 0, (unsigned int) -1, num);
 		break;
+	case PACKET_FANOUT_RND:
+		idx = fanout_demux_rnd(f, skb, num);
+		break;
+	case PACKET_FANOUT_QM:
+		idx = fanout_demux_qm(f, skb, num);
+		break;
+	case PACKET_FANOUT_CBPF:
+		idx = fanout_demux_bpf(f, skb, num);
+		break;
 	}
 
 	po = pkt_sk(f->arr[idx]);
 	if (fanout_has_flag(f, PACKET_FANOUT_FLAG_ROLLOVER) &&
 	    unlikely(!packet_rcv_has_room(po, skb))) {
+		struct packet_sock *full = po;
+
 		idx = fanout_demux_rollover(f, skb, idx, idx, num);
 		po = pkt_sk(f->arr[idx]);
+		if (po != full)
+			atomic_long_inc(&full->fanout_stats.rollover);
 	}
 
 	return po->prot_hook.func(skb, dev, &po->prot_hook, orig_dev);
@@ -1284,6 +1335,9 @@ static int fanout_add(struct sock *sk, u16 id, u16 type_flags)
 	case PACKET_FANOUT_HASH:
 	case PACKET_FANOUT_LB:
 	case PACKET_FANOUT_CPU:
+	case PACKET_FANOUT_RND:
+	case PACKET_FANOUT_QM:
+	case PACKET_FANOUT_CBPF:
 		break;
 	default:
 		return -EINVAL;
@@ -1359,13 +1413,61 @@ static void fanout_release(struct sock *sk)
 	po->fanout = NULL;
 
 	if (atomic_dec_and_test(&f->sk_ref)) {
+		struct sk_filter *prog;
+
 		list_del(&f->list);
 		dev_remove_pack(&f->prot_hook);
+		prog = rcu_dereference_protected(f->bpf_prog,
+					lockdep_is_held(&fanout_mutex));
+		if (prog)
+			sk_unattached_filter_destroy(prog);
 		kfree(f);
 	}
 	mutex_unlock(&fanout_mutex);
 }
 
+/* Attach a classic BPF program to a PACKET_FANOUT_CBPF group */
+static int fanout_set_data(struct packet_sock *po, struct sock_fprog *fprog)
+{
+	struct sock_filter *insns;
+	struct sk_filter *new, *old;
+	struct packet_fanout *f;
+	struct sock_fprog kprog;
+	int err;
+
+	if (!po->fanout || po->fanout->type != PACKET_FANOUT_CBPF)
+		return -EINVAL;
+	if (!fprog->len || fprog->len > BPF_MAXINSNS)
+		return -EINVAL;
+
+	insns = memdup_user(fprog->filter, sk_filter_proglen(fprog));
+	if (IS_ERR(insns))
+		return PTR_ERR(insns);
+
+	kprog.len = fprog->len;
+	kprog.filter = insns;
+	err = sk_unattached_filter_create(&new, &kprog);
+	kfree(insns);
+	if (err)
+		return err;
+
+	err = -EINVAL;
+	mutex_lock(&fanout_mutex);
+	f = po->fanout;
+	if (f && f->type == PACKET_FANOUT_CBPF) {
+		old = rcu_dereference_protected(f->bpf_prog,
+					lockdep_is_held(&fanout_mutex));
+		rcu_assign_pointer(f->bpf_prog, new);
+		new = old;
+		err = 0;
+	}
+	mutex_unlock(&fanout_mutex);
+
+	if (new)
+		sk_unattached_filter_destroy(new);
+	return err;
+}
+
 static const struct proto_ops packet_ops;
 
 static const struct proto_ops packet_ops_spkt;
@@ -1899,6 +2001,57 @@ ring_is_full:
 	goto drop_n_restore;
 }
 
+/*
+ * PACKET_QDISC_BYPASS: hand TX ring frames straight to the driver.  The
+ * TX queue is picked by CPU, so senders on different CPUs don't share a
+ * queue lock, and nothing is queued in software: a full queue is
+ * reported back with NETDEV_TX_BUSY and the skb is left to the caller,
+ * which falls back to the qdisc only for a blocking sender.
+ * Packet taps don't see the frames that bypass the qdisc.
+ */
+static u16 packet_pick_tx_queue(struct net_device *dev)
+{
+	return (u16)(raw_smp_processor_id() % dev->real_num_tx_queues);
+}
+
+static int packet_direct_xmit(struct sk_buff *skb)
+{
+	struct net_device *dev = skb->dev;
+	const struct net_device_ops *ops = dev->netdev_ops;
+	netdev_features_t features;
+	struct netdev_queue *txq;
+	int rc;
+
+	if (unlikely(!netif_running(dev) || !netif_carrier_ok(dev)))
+		goto drop;
+
+	features = netif_skb_features(skb);
+	if (skb_is_nonlinear(skb) &&
+	    (!(features & NETIF_F_SG) || !(features & NETIF_F_HIGHDMA)) &&
+	    __skb_linearize(skb))
+		goto drop;
+
+	skb_reset_mac_header(skb);
+	txq = netdev_get_tx_queue(dev, skb_get_queue_mapping(skb));
+
+	__netif_tx_lock_bh(txq);
+	if (unlikely(netif_xmit_frozen_or_stopped(txq))) {
+		rc = NETDEV_TX_BUSY;
+	} else {
+		rc = ops->ndo_start_xmit(skb, dev);
+		if (likely(rc == NETDEV_TX_OK))
+			txq_trans_update(txq);
+	}
+	__netif_tx_unlock_bh(txq);
+
+	return rc;
+
+drop:
+	atomic_long_inc(&dev->tx_dropped);
+	kfree_skb(skb);
+	return NET_XMIT_DROP;
+}
+
 static void tpacket_destruct_skb(struct sk_buff *skb)
 {
 	struct packet_sock *po = pkt_sk(skb->sk);
@@ -2133,7 +2286,34 @@ static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 		atomic_inc(&po->tx_ring.pending);
 
 		status = TP_STATUS_SEND_REQUEST;
-		err = dev_queue_xmit(skb);
+		if (po->tp_qdisc_bypass) {
+			skb_set_queue_mapping(skb, packet_pick_tx_queue(dev));
+			err = packet_direct_xmit(skb);
+			if (unlikely(!dev_xmit_complete(err))) {
+				if (msg->msg_flags & MSG_DONTWAIT) {
+					/*
+					 * TX queue full: the frame stays in
+					 * the ring as a send request, handed
+					 * back to the non blocking sender.
+					 */
+					skb->destructor = sock_wfree;
+					atomic_dec(&po->tx_ring.pending);
+					__packet_set_status(po, ph,
+							    TP_STATUS_SEND_REQUEST);
+					kfree_skb(skb);
+					err = len_sum ? : -ENOBUFS;
+					goto out_put;
+				}
+				/*
+				 * Rather than spin until the driver wakes
+				 * the queue, let the qdisc hold the frame of
+				 * a blocking sender.
+				 */
+				err = dev_queue_xmit(skb);
+			}
+		} else {
+			err = dev_queue_xmit(skb);
+		}
 		if (unlikely(err > 0)) {
 			err = net_xmit_errno(err);
 			if (err && __packet_get_status(po, ph) ==
@@ -3213,6 +3393,17 @@ packet_setsockopt(struct socket *sock, int level, int optname, char __user *optv
 
 		return fanout_add(sk, val & 0xffff, val >> 16);
 	}
+	case PACKET_FANOUT_DATA:
+	{
+		struct sock_fprog fprog;
+
+		if (optlen != sizeof(fprog))
+			return -EINVAL;
+		if (copy_from_user(&fprog, optval, sizeof(fprog)))
+			return -EFAULT;
+
+		return fanout_set_data(po, &fprog);
+	}
 	case PACKET_TX_HAS_OFF:
 	{
 		unsigned int val;
@@ -3226,6 +3417,17 @@ packet_setsockopt(struct socket *sock, int level, int optname, char __user *optv
 		po->tp_tx_has_off = !!val;
 		return 0;
 	}
+	case PACKET_QDISC_BYPASS:
+	{
+		int val;
+
+		if (optlen != sizeof(val))
+			return -EINVAL;
+		if (copy_from_user(&val, optval, sizeof(val)))
+			return -EFAULT;
+		po->tp_qdisc_bypass = !!val;
+		return 0;
+	}
 	default:
 		return -ENOPROTOOPT;
 	}
@@ -3240,6 +3442,7 @@ static int packet_getsockopt(struct socket *sock, int level, int optname,
 	struct packet_sock *po = pkt_sk(sk);
 	void *data = &val;
 	union tpacket_stats_u st;
+	struct tpacket_fanout_stats fst;
 
 	if (level != SOL_PACKET)
 		return -ENOPROTOOPT;
@@ -3255,6 +3458,8 @@ static int packet_getsockopt(struct socket *sock, int level, int optname,
 		spin_lock_bh(&sk->sk_receive_queue.lock);
 		memcpy(&st, &po->stats, sizeof(st));
 		memset(&po->stats, 0, sizeof(po->stats));
+		po->fanout_stats.packets += st.stats1.tp_packets;
+		po->fanout_stats.drops += st.stats1.tp_drops;
 		spin_unlock_bh(&sk->sk_receive_queue.lock);
 
 		if (po->tp_version == TPACKET_V3) {
@@ -3318,6 +3523,21 @@ static int packet_getsockopt(struct socket *sock, int level, int optname,
 	case PACKET_TX_HAS_OFF:
 		val = po->tp_tx_has_off;
 		break;
+	case PACKET_QDISC_BYPASS:
+		val = po->tp_qdisc_bypass;
+		break;
+	case PACKET_FANOUT_STATS:
+		spin_lock_bh(&sk->sk_receive_queue.lock);
+		fst.tp_packets = po->fanout_stats.packets +
+				 po->stats.stats1.tp_packets;
+		fst.tp_drops = po->fanout_stats.drops +
+			       po->stats.stats1.tp_drops;
+		spin_unlock_bh(&sk->sk_receive_queue.lock);
+		fst.tp_packets += fst.tp_drops;
+		fst.tp_rollover = atomic_long_read(&po->fanout_stats.rollover);
+		lv = sizeof(fst);
+		data = &fst;
+		break;
 	default:
 		return -ENOPROTOOPT;
 	}
@@ -3331,6 +3551,31 @@ static int packet_getsockopt(struct socket *sock, int level, int optname,
 	return 0;
 }
 
+#ifdef CONFIG_COMPAT
+static int compat_packet_setsockopt(struct socket *sock, int level,
+				    int optname, char __user *optval,
+				    unsigned int optlen)
+{
+	struct packet_sock *po = pkt_sk(sock->sk);
+
+	if (level == SOL_PACKET && optname == PACKET_FANOUT_DATA) {
+		struct compat_sock_fprog cfprog;
+		struct sock_fprog fprog;
+
+		if (optlen != sizeof(cfprog))
+			return -EINVAL;
+		if (copy_from_user(&cfprog, optval, sizeof(cfprog)))
+			return -EFAULT;
+
+		fprog.len = cfprog.len;
+		fprog.filter = compat_ptr(cfprog.filter);
+		return fanout_set_data(po, &fprog);
+	}
+
+	return packet_setsockopt(sock, level, optname, optval, optlen);
+}
+#endif
+
 
 static int packet_notifier(struct notifier_block *this, unsigned long msg, void *data)
 {
@@ -3808,6 +4053,9 @@ static const struct proto_ops packet_ops = {
 	.shutdown =	sock_no_shutdown,
 	.setsockopt =	packet_setsockopt,
 	.getsockopt =	packet_getsockopt,
+#ifdef CONFIG_COMPAT
+	.compat_setsockopt = compat_packet_setsockopt,
+#endif
 	.sendmsg =	packet_sendmsg,
 	.recvmsg =	packet_recvmsg,
 	.mmap =		packet_mmap,
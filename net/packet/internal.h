@@ -86,14 +86,23 @@ struct packet_fanout {
 	int			next[PACKET_FANOUT_MAX];
 	spinlock_t		lock;
 	atomic_t		sk_ref;
+	struct sk_filter __rcu	*bpf_prog;	/* PACKET_FANOUT_CBPF */
 	struct packet_type	prot_hook ____cacheline_aligned_in_smp;
 };
 
+/* Running totals of stats, which PACKET_STATISTICS clears */
+struct packet_fanout_stats {
+	u64			packets;
+	u64			drops;
+	atomic_long_t		rollover;
+};
+
 struct packet_sock {
 	/* struct sock has to be the first member of packet_sock */
 	struct sock		sk;
 	struct packet_fanout	*fanout;
 	union  tpacket_stats_u	stats;
+	struct packet_fanout_stats	fanout_stats;
 	struct packet_ring_buffer	rx_ring;
 	struct packet_ring_buffer	tx_ring;
 	int			copy_thresh;
@@ -112,6 +121,7 @@ struct packet_sock {
 	unsigned int		tp_reserve;
 	unsigned int		tp_loss:1;
 	unsigned int		tp_tx_has_off:1;
+	unsigned int		tp_qdisc_bypass:1;
 	unsigned int		tp_tstamp;
 	struct packet_type	prot_hook ____cacheline_aligned_in_smp;
 };
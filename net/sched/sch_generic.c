@@ -40,33 +40,108 @@
  * - updates to tree and tree walking are only done under the rtnl mutex.
  */
 
+/*
+ * A requeued skb is either a GSO packet, whose skb->next holds the
+ * segments not yet sent, or a chain of packets left over from a bulk
+ * dequeue, in which only the tail may be a GSO packet.
+ */
+static unsigned int requeued_skb_count(const struct sk_buff *skb)
+{
+	unsigned int n = 1;
+
+	if (!skb_is_gso(skb)) {
+		while ((skb = skb->next) != NULL)
+			n++;
+	}
+	return n;
+}
+
+static void requeued_skb_free(struct sk_buff *skb)
+{
+	if (skb_is_gso(skb))
+		kfree_skb(skb);
+	else
+		kfree_skb_list(skb);
+}
+
 static inline int dev_requeue_skb(struct sk_buff *skb, struct Qdisc *q)
 {
-	skb_dst_force(skb);
+	struct sk_buff *p;
+
+	for (p = skb; p; p = skb_is_gso(p) ? NULL : p->next)
+		skb_dst_force(p);
 	q->gso_skb = skb;
 	q->qstats.requeues++;
-	q->q.qlen++;	/* it's still part of the queue */
+	/* it's still part of the queue */
+	q->q.qlen += requeued_skb_count(skb);
 	__netif_schedule(q);
 
 	return 0;
 }
 
-static inline struct sk_buff *dequeue_skb(struct Qdisc *q)
+/* Bytes the driver can still take before BQL throttles the queue */
+static inline int qdisc_avail_bulklimit(const struct netdev_queue *txq)
+{
+#ifdef CONFIG_BQL
+	/* drivers without BQL support never open their limit */
+	return dql_avail(&txq->dql);
+#else
+	return 0;
+#endif
+}
+
+/*
+ * Dequeue more packets behind @skb while the byte budget of the tx queue
+ * allows, chaining them on skb->next. A GSO packet is segmented later on
+ * and uses skb->next for its segments, so it always ends the chain.
+ */
+static void try_bulk_dequeue_skb(struct Qdisc *q, struct sk_buff *skb,
+				 const struct netdev_queue *txq)
+{
+	int bytelimit = qdisc_avail_bulklimit(txq) - skb->len;
+
+	while (bytelimit > 0) {
+		struct sk_buff *nskb = q->dequeue(q);
+
+		if (!nskb)
+			break;
+
+		bytelimit -= nskb->len;
+		skb->next = nskb;
+		skb = nskb;
+		if (skb_is_gso(nskb))
+			break;
+	}
+	skb->next = NULL;
+}
+
+/*
+ * Requeued packets were validated before they first went to the driver,
+ * *validate tells whether the packets returned still need to be.
+ */
+static inline struct sk_buff *dequeue_skb(struct Qdisc *q, bool *validate)
 {
 	struct sk_buff *skb = q->gso_skb;
 	const struct netdev_queue *txq = q->dev_queue;
 
+	*validate = true;
 	if (unlikely(skb)) {
+		*validate = false;
 		/* check the reason of requeuing without tx lock first */
 		txq = netdev_get_tx_queue(txq->dev, skb_get_queue_mapping(skb));
 		if (!netif_xmit_frozen_or_stopped(txq)) {
 			q->gso_skb = NULL;
-			q->q.qlen--;
+			q->q.qlen -= requeued_skb_count(skb);
 		} else
 			skb = NULL;
-	} else {
-		if (!(q->flags & TCQ_F_ONETXQUEUE) || !netif_xmit_frozen_or_stopped(txq))
+	} else if (q->flags & TCQ_F_ONETXQUEUE) {
+		if (!netif_xmit_frozen_or_stopped(txq)) {
 			skb = q->dequeue(q);
+			if (skb && !skb_is_gso(skb))
+				try_bulk_dequeue_skb(q, skb, txq);
+		}
+	} else {
+		skb = q->dequeue(q);
 	}
 
 	return skb;
@@ -85,7 +160,7 @@ static inline int handle_dev_cpu_collision(struct sk_buff *skb,
 		 * detect it by checking xmit owner and drop the packet when
 		 * deadloop is detected. Return OK to try the next skb.
 		 */
-		kfree_skb(skb);
+		requeued_skb_free(skb);
 		net_warn_ratelimited("Dead loop on netdevice %s, fix it urgently!\n",
 				     dev_queue->dev->name);
 		ret = qdisc_qlen(q);
@@ -102,9 +177,52 @@ static inline int handle_dev_cpu_collision(struct sk_buff *skb,
 }
 
 /*
- * Transmit one skb, and handle the return status as required. Holding the
- * __QDISC_STATE_RUNNING bit guarantees that only one CPU can execute this
- * function.
+ * Hand the packets chained on @skb to the driver, all but the last one
+ * flagged with xmit_more so that the driver can defer its doorbell. On
+ * failure *@skbp is left pointing at the packets still to be sent.
+ */
+static int dev_hard_start_xmit_list(struct sk_buff **skbp,
+				    struct net_device *dev,
+				    struct netdev_queue *txq)
+{
+	struct sk_buff *skb = *skbp;
+	int rc = NETDEV_TX_OK;
+
+	while (skb) {
+		struct sk_buff *next = NULL;
+
+		/* skb->next of a GSO packet carries its own segments */
+		if (!skb_is_gso(skb)) {
+			next = skb->next;
+			skb->next = NULL;
+		}
+		skb->xmit_more = next ? 1 : 0;
+
+		rc = dev_hard_start_xmit(skb, dev, txq);
+		if (unlikely(!dev_xmit_complete(rc))) {
+			if (next)
+				skb->next = next;
+			break;
+		}
+
+		skb = next;
+		if (skb && netif_xmit_frozen_or_stopped(txq)) {
+			rc = NETDEV_TX_BUSY;
+			break;
+		}
+	}
+
+	*skbp = skb;
+	return rc;
+}
+
+/*
+ * Transmit one skb, or the chain of skbs returned by a bulk dequeue, and
+ * handle the return status as required. Unless @validate is false, the
+ * packets are first made ready for the driver, dropping those that can't
+ * be sent, so that the one flagged last of the batch reaches the driver
+ * and rings the doorbell. Holding the __QDISC_STATE_RUNNING bit
+ * guarantees that only one CPU can execute this function.
  *
  * Returns to the caller:
  *				0  - queue is empty or throttled.
@@ -112,16 +230,24 @@ static inline int handle_dev_cpu_collision(struct sk_buff *skb,
  */
 int sch_direct_xmit(struct sk_buff *skb, struct Qdisc *q,
 		    struct net_device *dev, struct netdev_queue *txq,
-		    spinlock_t *root_lock)
+		    spinlock_t *root_lock, bool validate)
 {
 	int ret = NETDEV_TX_BUSY;
 
 	/* And release qdisc */
 	spin_unlock(root_lock);
 
+	if (validate) {
+		skb = validate_xmit_skb_list(skb, dev);
+		if (unlikely(!skb)) {
+			spin_lock(root_lock);
+			return qdisc_qlen(q);
+		}
+	}
+
 	HARD_TX_LOCK(dev, txq, smp_processor_id());
 	if (!netif_xmit_frozen_or_stopped(txq))
-		ret = dev_hard_start_xmit(skb, dev, txq);
+		ret = dev_hard_start_xmit_list(&skb, dev, txq);
 
 	HARD_TX_UNLOCK(dev, txq);
 
@@ -173,9 +299,10 @@ static inline int qdisc_restart(struct Qdisc *q)
 	struct net_device *dev;
 	spinlock_t *root_lock;
 	struct sk_buff *skb;
+	bool validate;
 
 	/* Dequeue packet */
-	skb = dequeue_skb(q);
+	skb = dequeue_skb(q, &validate);
 	if (unlikely(!skb))
 		return 0;
 	WARN_ON_ONCE(skb_dst_is_noref(skb));
@@ -183,7 +310,7 @@ static inline int qdisc_restart(struct Qdisc *q)
 	dev = qdisc_dev(q);
 	txq = netdev_get_tx_queue(dev, skb_get_queue_mapping(skb));
 
-	return sch_direct_xmit(skb, q, dev, txq, root_lock);
+	return sch_direct_xmit(skb, q, dev, txq, root_lock, validate);
 }
 
 void __qdisc_run(struct Qdisc *q)
@@ -602,7 +729,7 @@ void qdisc_reset(struct Qdisc *qdisc)
 		ops->reset(qdisc);
 
 	if (qdisc->gso_skb) {
-		kfree_skb(qdisc->gso_skb);
+		requeued_skb_free(qdisc->gso_skb);
 		qdisc->gso_skb = NULL;
 		qdisc->q.qlen = 0;
 	}
@@ -638,7 +765,8 @@ void qdisc_destroy(struct Qdisc *qdisc)
 	module_put(ops->owner);
 	dev_put(qdisc_dev(qdisc));
 
-	kfree_skb(qdisc->gso_skb);
+	if (qdisc->gso_skb)
+		requeued_skb_free(qdisc->gso_skb);
 	/*
 	 * gen_estimator est_timer() might access qdisc->q.lock,
 	 * wait a RCU grace period before freeing qdisc.
@@ -118,19 +118,19 @@
 
 struct hlist_head unix_socket_table[2 * UNIX_HASH_SIZE];
 EXPORT_SYMBOL_GPL(unix_socket_table);
-DEFINE_SPINLOCK(unix_table_lock);
-EXPORT_SYMBOL_GPL(unix_table_lock);
+spinlock_t unix_table_locks[2 * UNIX_HASH_SIZE];
+EXPORT_SYMBOL_GPL(unix_table_locks);
 static atomic_long_t unix_nr_socks;
 
 
-static struct hlist_head *unix_sockets_unbound(void *addr)
+static unsigned int unix_unbound_hash(struct sock *sk)
 {
-	unsigned long hash = (unsigned long)addr;
+	unsigned long hash = (unsigned long)sk;
 
 	hash ^= hash >> 16;
 	hash ^= hash >> 8;
 	hash %= UNIX_HASH_SIZE;
-	return &unix_socket_table[UNIX_HASH_SIZE + hash];
+	return UNIX_HASH_SIZE + hash;
 }
 
 #define UNIX_ABSTRACT(sk)	(unix_sk(sk)->addr->hash < UNIX_HASH_SIZE)
@@ -155,7 +155,12 @@ static inline void unix_set_secdata(struct scm_cookie *scm, struct sk_buff *skb)
 
 /*
  *  SMP locking strategy:
- *    hash table is protected with spinlock unix_table_lock
+ *    each hash bucket is protected by its spinlock in unix_table_locks,
+ *    sk->sk_hash is the bucket the socket is hashed in.  Lookups of bound
+ *    sockets walk the first half of the table under rcu_read_lock(): a
+ *    socket enters a bound bucket once, when it is bound, and only
+ *    leaves it on release, and unix sockets are freed after a grace
+ *    period (SOCK_RCU_FREE).
  *    each socket state is protected by separate spin lock.
  */
 
@@ -234,38 +239,67 @@ static int unix_mkname(struct sockaddr_un *sunaddr, int len, unsigned int *hashp
 	return len;
 }
 
+/* Keeps ->next intact for concurrent lockless readers */
 static void __unix_remove_socket(struct sock *sk)
 {
-	sk_del_node_init(sk);
+	if (!sk_unhashed(sk)) {
+		hlist_del_init_rcu(&sk->sk_node);
+		__sock_put(sk);
+	}
 }
 
-static void __unix_insert_socket(struct hlist_head *list, struct sock *sk)
+static void __unix_insert_socket(struct sock *sk, unsigned int hash)
 {
 	WARN_ON(!sk_unhashed(sk));
-	sk_add_node(sk, list);
+	sk->sk_hash = hash;
+	sk_add_node_rcu(sk, &unix_socket_table[hash]);
 }
 
 static inline void unix_remove_socket(struct sock *sk)
 {
-	spin_lock(&unix_table_lock);
+	spinlock_t *lock = &unix_table_locks[sk->sk_hash];
+
+	spin_lock(lock);
 	__unix_remove_socket(sk);
-	spin_unlock(&unix_table_lock);
+	spin_unlock(lock);
 }
 
-static inline void unix_insert_socket(struct hlist_head *list, struct sock *sk)
+static inline void unix_insert_socket(struct sock *sk, unsigned int hash)
 {
-	spin_lock(&unix_table_lock);
-	__unix_insert_socket(list, sk);
-	spin_unlock(&unix_table_lock);
+	spin_lock(&unix_table_locks[hash]);
+	__unix_insert_socket(sk, hash);
+	spin_unlock(&unix_table_locks[hash]);
 }
 
+/* Binding moves a socket from its unbound bucket to a bound one */
+static void unix_table_double_lock(unsigned int hash1, unsigned int hash2)
+{
+	if (hash1 == hash2) {
+		spin_lock(&unix_table_locks[hash1]);
+		return;
+	}
+	if (hash1 > hash2)
+		swap(hash1, hash2);
+
+	spin_lock(&unix_table_locks[hash1]);
+	spin_lock_nested(&unix_table_locks[hash2], SINGLE_DEPTH_NESTING);
+}
+
+static void unix_table_double_unlock(unsigned int hash1, unsigned int hash2)
+{
+	if (hash1 != hash2)
+		spin_unlock(&unix_table_locks[hash2]);
+	spin_unlock(&unix_table_locks[hash1]);
+}
+
+/* Called with the bucket lock or rcu_read_lock() held */
 static struct sock *__unix_find_socket_byname(struct net *net,
 					      struct sockaddr_un *sunname,
 					      int len, int type, unsigned int hash)
 {
 	struct sock *s;
 
-	sk_for_each(s, &unix_socket_table[hash ^ type]) {
+	sk_for_each_rcu(s, &unix_socket_table[hash ^ type]) {
 		struct unix_sock *u = unix_sk(s);
 
 		if (!net_eq(sock_net(s), net))
@@ -287,11 +321,11 @@ static inline struct sock *unix_find_socket_byname(struct net *net,
 {
 	struct sock *s;
 
-	spin_lock(&unix_table_lock);
+	rcu_read_lock();
 	s = __unix_find_socket_byname(net, sunname, len, type, hash);
-	if (s)
-		sock_hold(s);
-	spin_unlock(&unix_table_lock);
+	if (s && unlikely(!atomic_inc_not_zero(&s->sk_refcnt)))
+		s = NULL;
+	rcu_read_unlock();
 	return s;
 }
 
@@ -299,19 +333,20 @@ static struct sock *unix_find_socket_byinode(struct inode *i)
 {
 	struct sock *s;
 
-	spin_lock(&unix_table_lock);
-	sk_for_each(s,
-		    &unix_socket_table[i->i_ino & (UNIX_HASH_SIZE - 1)]) {
-		struct dentry *dentry = unix_sk(s)->path.dentry;
+	rcu_read_lock();
+	sk_for_each_rcu(s,
+			&unix_socket_table[i->i_ino & (UNIX_HASH_SIZE - 1)]) {
+		struct dentry *dentry = ACCESS_ONCE(unix_sk(s)->path.dentry);
 
 		if (dentry && dentry->d_inode == i) {
-			sock_hold(s);
+			if (unlikely(!atomic_inc_not_zero(&s->sk_refcnt)))
+				break;
 			goto found;
 		}
 	}
 	s = NULL;
 found:
-	spin_unlock(&unix_table_lock);
+	rcu_read_unlock();
 	return s;
 }
 
@@ -648,7 +683,8 @@ static struct sock *unix_create1(struct net *net, struct socket *sock)
 	INIT_LIST_HEAD(&u->link);
 	mutex_init(&u->readlock); /* single task reading lock */
 	init_waitqueue_head(&u->peer_wait);
-	unix_insert_socket(unix_sockets_unbound(sk), sk);
+	sock_set_flag(sk, SOCK_RCU_FREE);
+	unix_insert_socket(sk, unix_unbound_hash(sk));
 out:
 	if (sk == NULL)
 		atomic_long_dec(&unix_nr_socks);
@@ -711,6 +747,8 @@ static int unix_autobind(struct socket *sock)
 	struct unix_sock *u = unix_sk(sk);
 	static u32 ordernum = 1;
 	struct unix_address *addr;
+	unsigned int old_hash = sk->sk_hash;
+	unsigned int new_hash;
 	int err;
 	unsigned int retries = 0;
 
@@ -731,13 +769,14 @@ static int unix_autobind(struct socket *sock)
 retry:
 	addr->len = sprintf(addr->name->sun_path+1, "%05x", ordernum) + 1 + sizeof(short);
 	addr->hash = unix_hash_fold(csum_partial(addr->name, addr->len, 0));
+	new_hash = addr->hash ^ sk->sk_type;
 
-	spin_lock(&unix_table_lock);
+	unix_table_double_lock(old_hash, new_hash);
 	ordernum = (ordernum+1)&0xFFFFF;
 
 	if (__unix_find_socket_byname(net, addr->name, addr->len, sock->type,
 				      addr->hash)) {
-		spin_unlock(&unix_table_lock);
+		unix_table_double_unlock(old_hash, new_hash);
 		/*
 		 * __unix_find_socket_byname() may take long time if many names
 		 * are already in use.
@@ -751,12 +790,12 @@ retry:
 		}
 		goto retry;
 	}
-	addr->hash ^= sk->sk_type;
+	addr->hash = new_hash;
 
 	__unix_remove_socket(sk);
 	u->addr = addr;
-	__unix_insert_socket(&unix_socket_table[addr->hash], sk);
-	spin_unlock(&unix_table_lock);
+	__unix_insert_socket(sk, new_hash);
+	unix_table_double_unlock(old_hash, new_hash);
 	err = 0;
 
 out:	mutex_unlock(&u->readlock);
@@ -855,9 +894,8 @@ static int unix_bind(struct socket *sock, struct sockaddr *uaddr, int addr_len)
 	struct sockaddr_un *sunaddr = (struct sockaddr_un *)uaddr;
 	char *sun_path = sunaddr->sun_path;
 	int err;
-	unsigned int hash;
+	unsigned int hash, old_hash = sk->sk_hash;
 	struct unix_address *addr;
-	struct hlist_head *list;
 
 	err = -EINVAL;
 	if (sunaddr->sun_family != AF_UNIX)
@@ -902,28 +940,28 @@ static int unix_bind(struct socket *sock, struct sockaddr *uaddr, int addr_len)
 		}
 		addr->hash = UNIX_HASH_SIZE;
 		hash = path.dentry->d_inode->i_ino & (UNIX_HASH_SIZE-1);
-		spin_lock(&unix_table_lock);
+		unix_table_double_lock(old_hash, hash);
 		u->path = path;
-		list = &unix_socket_table[hash];
 	} else {
-		spin_lock(&unix_table_lock);
+		unsigned int name_hash = hash;
+
+		hash = addr->hash;
+		unix_table_double_lock(old_hash, hash);
 		err = -EADDRINUSE;
 		if (__unix_find_socket_byname(net, sunaddr, addr_len,
-					      sk->sk_type, hash)) {
+					      sk->sk_type, name_hash)) {
 			unix_release_addr(addr);
 			goto out_unlock;
 		}
-
-		list = &unix_socket_table[addr->hash];
 	}
 
 	err = 0;
 	__unix_remove_socket(sk);
 	u->addr = addr;
-	__unix_insert_socket(list, sk);
+	__unix_insert_socket(sk, hash);
 
 out_unlock:
-	spin_unlock(&unix_table_lock);
+	unix_table_double_unlock(old_hash, hash);
 out_up:
 	mutex_unlock(&u->readlock);
 out:
@@ -1453,11 +1491,12 @@ static int unix_dgram_sendmsg(struct kiocb *kiocb, struct socket *sock,
 
 	if (NULL == siocb->scm)
 		siocb->scm = &tmp_scm;
-	wait_for_unix_gc();
 	err = scm_send(sock, msg, siocb->scm, false);
 	if (err < 0)
 		return err;
 
+	wait_for_unix_gc(siocb->scm->fp);
+
 	err = -EOPNOTSUPP;
 	if (msg->msg_flags&MSG_OOB)
 		goto out;
@@ -1622,11 +1661,12 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 
 	if (NULL == siocb->scm)
 		siocb->scm = &tmp_scm;
-	wait_for_unix_gc();
 	err = scm_send(sock, msg, siocb->scm, false);
 	if (err < 0)
 		return err;
 
+	wait_for_unix_gc(siocb->scm->fp);
+
 	err = -EOPNOTSUPP;
 	if (msg->msg_flags&MSG_OOB)
 		goto out_err;
@@ -2275,11 +2315,12 @@ static struct sock *unix_from_bucket(struct seq_file *seq, loff_t *pos)
 	return sk;
 }
 
+/* Returns with the lock of the bucket of the socket returned held */
 static struct sock *unix_next_socket(struct seq_file *seq,
 				     struct sock *sk,
 				     loff_t *pos)
 {
-	unsigned long bucket;
+	unsigned long bucket = get_bucket(*pos);
 
 	while (sk > (struct sock *)SEQ_START_TOKEN) {
 		sk = sk_next(sk);
@@ -2290,12 +2331,13 @@ static struct sock *unix_next_socket(struct seq_file *seq,
 	}
 
 	do {
+		spin_lock(&unix_table_locks[bucket]);
 		sk = unix_from_bucket(seq, pos);
 		if (sk)
 			return sk;
 
 next_bucket:
-		bucket = get_bucket(*pos) + 1;
+		spin_unlock(&unix_table_locks[bucket++]);
 		*pos = set_bucket_offset(bucket, 1);
 	} while (bucket < ARRAY_SIZE(unix_socket_table));
 
@@ -2303,10 +2345,7 @@ next_bucket:
 }
 
 static void *unix_seq_start(struct seq_file *seq, loff_t *pos)
-	__acquires(unix_table_lock)
 {
-	spin_lock(&unix_table_lock);
-
 	if (!*pos)
 		return SEQ_START_TOKEN;
 
@@ -2323,9 +2362,11 @@ static void *unix_seq_next(struct seq_file *seq, void *v, loff_t *pos)
 }
 
 static void unix_seq_stop(struct seq_file *seq, void *v)
-	__releases(unix_table_lock)
 {
-	spin_unlock(&unix_table_lock);
+	struct sock *sk = v;
+
+	if (sk && v != SEQ_START_TOKEN)
+		spin_unlock(&unix_table_locks[sk->sk_hash]);
 }
 
 static int unix_seq_show(struct seq_file *seq, void *v)
@@ -2435,9 +2476,13 @@ static struct pernet_operations unix_net_ops = {
 static int __init af_unix_init(void)
 {
 	int rc = -1;
+	int i;
 
 	BUILD_BUG_ON(sizeof(struct unix_skb_parms) > FIELD_SIZEOF(struct sk_buff, cb));
 
+	for (i = 0; i < 2 * UNIX_HASH_SIZE; i++)
+		spin_lock_init(&unix_table_locks[i]);
+
 	rc = proto_register(&unix_proto, 1);
 	if (rc != 0) {
 		printk(KERN_CRIT "%s: Cannot create unix_sock SLAB cache!\n",
@@ -2454,6 +2499,7 @@ out:
 static void __exit af_unix_exit(void)
 {
 	sock_unregister(PF_UNIX);
+	unix_gc_exit();
 	proto_unregister(&unix_proto);
 	unregister_pernet_subsys(&unix_net_ops);
 }
@@ -80,6 +80,7 @@
 #include <linux/proc_fs.h>
 #include <linux/mutex.h>
 #include <linux/wait.h>
+#include <linux/workqueue.h>
 
 #include <net/sock.h>
 #include <net/af_unix.h>
@@ -261,19 +262,48 @@ static void inc_inflight_move_tail(struct unix_sock *u)
 static bool gc_in_progress = false;
 #define UNIX_INFLIGHT_TRIGGER_GC 16000
 
-void wait_for_unix_gc(void)
+static void __unix_gc(struct work_struct *work);
+static DECLARE_WORK(unix_gc_work, __unix_gc);
+
+void wait_for_unix_gc(struct scm_fp_list *fpl)
 {
 	/*
-	 * If number of inflight sockets is insane,
-	 * force a garbage collect right now.
+	 * Only senders of file descriptors can grow the garbage, the
+	 * others never wait for the collector.
+	 */
+	if (!fpl)
+		return;
+
+	/*
+	 * If number of inflight sockets is insane, start a collection
+	 * and hold the sender back only while one is running.  Below
+	 * the threshold senders never wait for the collector.
 	 */
-	if (unix_tot_inflight > UNIX_INFLIGHT_TRIGGER_GC && !gc_in_progress)
+	if (unix_tot_inflight > UNIX_INFLIGHT_TRIGGER_GC) {
 		unix_gc();
-	wait_event(unix_gc_wait, gc_in_progress == false);
+		wait_event(unix_gc_wait, gc_in_progress == false);
+	}
 }
 
-/* The external entry point: unix_gc() */
+/*
+ * The external entry point: unix_gc()
+ *
+ * Collection runs from a work item, so closing a socket never walks the
+ * in-flight graph itself and requests made while a run is pending are
+ * merged into that run.
+ */
 void unix_gc(void)
+{
+	queue_work(system_unbound_wq, &unix_gc_work);
+}
+
+/* Module unload: no run may be left pending on the workqueue. */
+void unix_gc_exit(void)
+{
+	cancel_work_sync(&unix_gc_work);
+}
+
+static void __unix_gc(struct work_struct *work)
 {
 	struct unix_sock *u;
 	struct unix_sock *next;